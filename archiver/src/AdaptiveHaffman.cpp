@@ -0,0 +1,106 @@
+#include "AdaptiveHaffman.h"
+#include <stdexcept>
+#include <string>
+
+AdaptiveHaffman::AdaptiveHaffman()
+    : nodes_(2 * ALPHABET_SIZE + 1), leaves_(ALPHABET_SIZE, NO_NODE), root_(nodes_.size() - 1), nyt_(root_) {
+    path_.reserve(nodes_.size());
+    nodes_[root_] = {0, NO_NODE, NO_NODE, NO_NODE, NO_NODE};
+}
+
+bool AdaptiveHaffman::IsLeaf(size_t node) const {
+    return nodes_[node].left == NO_NODE;
+}
+
+void AdaptiveHaffman::SwapNodes(size_t first, size_t second) {
+    std::swap(nodes_[first].left, nodes_[second].left);
+    std::swap(nodes_[first].right, nodes_[second].right);
+    std::swap(nodes_[first].symbol, nodes_[second].symbol);
+    std::swap(nodes_[first].weight, nodes_[second].weight);
+    for (size_t node : {first, second}) {
+        if (IsLeaf(node)) {
+            if (nodes_[node].symbol != NO_NODE) {
+                leaves_[nodes_[node].symbol] = node;
+            } else {
+                nyt_ = node;
+            }
+        } else {
+            nodes_[nodes_[node].left].parent = node;
+            nodes_[nodes_[node].right].parent = node;
+        }
+    }
+}
+
+void AdaptiveHaffman::Update(size_t symbol) {
+    size_t node = leaves_[symbol];
+    if (node == NO_NODE) {
+        size_t old_nyt = nyt_;
+        nyt_ = old_nyt - 2;
+        node = old_nyt - 1;
+        nodes_[nyt_] = {0, old_nyt, NO_NODE, NO_NODE, NO_NODE};
+        nodes_[node] = {0, old_nyt, NO_NODE, NO_NODE, symbol};
+        nodes_[old_nyt].left = nyt_;
+        nodes_[old_nyt].right = node;
+        leaves_[symbol] = node;
+    }
+    while (node != NO_NODE) {
+        size_t leader = node;
+        while (leader + 1 < nodes_.size() && nodes_[leader + 1].weight == nodes_[node].weight) {
+            ++leader;
+        }
+        if (leader != node && leader != nodes_[node].parent) {
+            SwapNodes(node, leader);
+            node = leader;
+        }
+        ++nodes_[node].weight;
+        node = nodes_[node].parent;
+    }
+}
+
+void AdaptiveHaffman::Encode(size_t symbol, Stream &writer) {
+    if (symbol >= ALPHABET_SIZE) {
+        throw std::runtime_error("Symbol " + std::to_string(symbol) + " can't be encoded adaptively!");
+    }
+    size_t node = leaves_[symbol] == NO_NODE ? nyt_ : leaves_[symbol];
+    path_.clear();
+    for (; node != root_; node = nodes_[node].parent) {
+        path_.push_back(nodes_[nodes_[node].parent].right == node);
+    }
+    uint64_t chunk = 0;
+    size_t chunk_size = 0;
+    for (auto bit = path_.rbegin(); bit != path_.rend(); ++bit) {
+        chunk = (chunk << 1) | *bit;
+        if (++chunk_size == Stream::MAX_WRITE_BITS) {
+            writer.WriteBits(chunk, chunk_size);
+            chunk = 0;
+            chunk_size = 0;
+        }
+    }
+    writer.WriteBits(chunk, chunk_size);
+    if (leaves_[symbol] == NO_NODE) {
+        writer.WriteBits(symbol, SYMBOL_BITS);
+    }
+    Update(symbol);
+}
+
+std::optional<size_t> AdaptiveHaffman::Decode(Stream &reader) {
+    size_t node = root_;
+    while (!IsLeaf(node)) {
+        if (reader.Eof()) {
+            return std::nullopt;
+        }
+        node = reader.ReadUInt(1) ? nodes_[node].right : nodes_[node].left;
+    }
+    size_t symbol = nodes_[node].symbol;
+    if (node == nyt_) {
+        if (reader.Eof()) {
+            return std::nullopt;
+        }
+        symbol = reader.ReadUInt(SYMBOL_BITS);
+        if (symbol >= ALPHABET_SIZE || leaves_[symbol] != NO_NODE) {
+            return std::nullopt;
+        }
+    }
+    Update(symbol);
+    return symbol;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <optional>
+#include <vector>
+#include "Stream.h"
+
+class AdaptiveHaffman {
+private:
+    struct Node {
+        size_t weight = 0;
+        size_t parent;
+        size_t left;
+        size_t right;
+        size_t symbol;
+    };
+
+    std::vector<Node> nodes_;
+    std::vector<size_t> leaves_;
+    std::vector<bool> path_;
+    size_t root_;
+    size_t nyt_;
+
+    bool IsLeaf(size_t node) const;
+
+    void SwapNodes(size_t first, size_t second);
+
+    void Update(size_t symbol);
+
+public:
+    static constexpr size_t ALPHABET_SIZE = 257;
+    static constexpr size_t END_SYMBOL = 256;
+    static constexpr size_t SYMBOL_BITS = 9;
+    static constexpr size_t NO_NODE = static_cast<size_t>(-1);
+
+    AdaptiveHaffman();
+
+    void Encode(size_t symbol, Stream &writer);
+
+    std::optional<size_t> Decode(Stream &reader);
+};
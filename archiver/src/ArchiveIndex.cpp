@@ -0,0 +1,74 @@
+#include "ArchiveIndex.h"
+
+ArchiveIndex::ArchiveIndex(std::vector<MemberInfo> members) : members_(std::move(members)) {
+}
+
+void ArchiveIndex::AddMember(MemberInfo member) {
+    members_.push_back(std::move(member));
+}
+
+const std::vector<MemberInfo> &ArchiveIndex::GetMembers() const {
+    return members_;
+}
+
+const MemberInfo *ArchiveIndex::FindMember(std::string_view name) const {
+    // Files appended again to an archive shadow their older copies.
+    for (auto member = members_.rbegin(); member != members_.rend(); ++member) {
+        if (member->name == name) {
+            return &*member;
+        }
+    }
+    return nullptr;
+}
+
+void ArchiveIndex::Write(Stream &writer) const {
+    writer.AlignToByte();
+    size_t index_offset = writer.BitsWritten() / 8;
+    writer.WriteNumber(members_.size(), 32);
+    for (const MemberInfo &member : members_) {
+        writer.WriteNumber(member.name.size(), 16);
+        writer.WriteBytes(member.name.data(), member.name.size());
+        writer.WriteNumber(member.original_size, 64);
+        writer.WriteNumber(member.offset, 64);
+        writer.WriteNumber(member.compressed_size, 64);
+    }
+    writer.WriteNumber(index_offset, 64);
+    writer.WriteNumber(INDEX_MAGIC, 32);
+}
+
+std::optional<ArchiveIndex> ArchiveIndex::Read(Stream &reader) {
+    size_t archive_size = reader.Size();
+    if (archive_size < TRAILER_SIZE) {
+        return std::nullopt;
+    }
+    reader.Seek(archive_size - TRAILER_SIZE);
+    size_t index_offset = reader.ReadUInt(64);
+    if (reader.ReadUInt(32) != INDEX_MAGIC || index_offset >= archive_size - TRAILER_SIZE) {
+        return std::nullopt;
+    }
+
+    reader.Seek(index_offset);
+    size_t members_count = reader.ReadUInt(32);
+    if (members_count * MIN_ENTRY_SIZE > archive_size - index_offset) {
+        return std::nullopt;
+    }
+    ArchiveIndex index;
+    for (size_t i = 0; i < members_count; ++i) {
+        MemberInfo member;
+        member.name.resize(reader.ReadUInt(16));
+        if (reader.ReadBytes(member.name.data(), member.name.size()) != member.name.size()) {
+            return std::nullopt;
+        }
+        member.original_size = reader.ReadUInt(64);
+        member.offset = reader.ReadUInt(64);
+        member.compressed_size = reader.ReadUInt(64);
+        if (member.offset + member.compressed_size > index_offset) {
+            return std::nullopt;
+        }
+        index.AddMember(std::move(member));
+    }
+    if (reader.Tell() != archive_size - TRAILER_SIZE) {
+        return std::nullopt;
+    }
+    return index;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <vector>
+#include "Stream.h"
+
+struct MemberInfo {
+    std::string name;
+    size_t original_size = 0;
+    size_t offset = 0;
+    size_t compressed_size = 0;
+};
+
+class ArchiveIndex {
+private:
+    std::vector<MemberInfo> members_;
+
+public:
+    static constexpr size_t INDEX_MAGIC = 0x48414958;
+    static constexpr size_t TRAILER_SIZE = 12;
+    static constexpr size_t MIN_ENTRY_SIZE = 26;
+
+    ArchiveIndex() = default;
+
+    explicit ArchiveIndex(std::vector<MemberInfo> members);
+
+    void AddMember(MemberInfo member);
+
+    const std::vector<MemberInfo> &GetMembers() const;
+
+    const MemberInfo *FindMember(std::string_view name) const;
+
+    void Write(Stream &writer) const;
+
+    static std::optional<ArchiveIndex> Read(Stream &reader);
+};
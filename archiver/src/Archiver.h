@@ -2,8 +2,19 @@
 #include <iostream>
 #include <vector>
 #include <fstream>
+#include <deque>
+#include <filesystem>
+#include <functional>
 #include "HaffmanTree.h"
+#include "AdaptiveHaffman.h"
+#include "Histogram.h"
+#include "CompressStats.h"
+#include "Crc32c.h"
 #include "Stream.h"
+#include "ArchiveIndex.h"
+#include "FileWalker.h"
+#include "PathUtils.h"
+#include "ThreadPool.h"
 
 const int ERROR_CODE = 111;
 const int BYTE_SIZE = 9;
@@ -12,28 +23,257 @@ const size_t FILENAME_END = 256;
 const size_t ONE_MORE_FILE = 257;
 const size_t ARCHIVE_END = 258;
 
+const size_t FORMAT_MAGIC = 0x4841;
+const size_t BLOCK_FORMAT_VERSION = 4;
+const size_t MIN_BLOCK_FORMAT_VERSION = 2;
+// Starting with this version every member and solid group ends with the CRC-32C of its original data.
+const size_t CHECKSUM_FORMAT_VERSION = 3;
+// Starting with this version the checksum also covers the record in front of the blocks: the name of a
+// member, and the names and sizes of the members of a solid group.
+const size_t RECORD_CHECKSUM_FORMAT_VERSION = 4;
+const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+const size_t MAX_BLOCK_SIZE = 1 << 28;
+const size_t MAX_FILENAME_SIZE = (1 << 16) - 1;
+const size_t MAX_TABLE_HEADER_SIZE = 1024;
+const size_t READ_CHUNK_SIZE = 1 << 16;
+// Upper bound of -j relative to the number of hardware threads.
+const size_t MAX_THREADS_PER_CORE = 4;
+
+const size_t ARCHIVE_END_TAG = 0;
+const size_t MEMBER_TAG = 1;
+const size_t SOLID_TAG = 2;
+
+const size_t BLOCK_END = 0;
+const size_t BLOCK_HAFFMAN = 1;
+const size_t BLOCK_ADAPTIVE = 2;
+const size_t BLOCK_HAFFMAN_INTERLEAVED = 3;
+const size_t BLOCK_STORED = 4;
+
+const size_t INTERLEAVED_STREAMS_COUNT = 4;
+const size_t MIN_INTERLEAVED_BLOCK_SIZE = 4096;
+// Blocks whose Haffman coding saves less than 1/MIN_SAVINGS_RATIO of their size are stored as is.
+const size_t MIN_SAVINGS_RATIO = 32;
+
 const std::string_view HELP_COMMAND_STR =
     "Programm works with following commands:\n"
     "archiver -c archive_name file1 [file2 ...] - archive files file1, file2, ... and save result "
     "in file archive_name\n"
+    "archiver -c archive_name dir1 [dir2 ...] - archive directories recursively, keeping paths relative to "
+    "the parent of every directory (dir1/sub/file); -d recreates the directory tree\n"
+    "archiver -j N -c archive_name file1 [file2 ...] - same as -c, but compresses up to N files in parallel "
+    "(N from 1 to 4 threads per core); a single large file is counted in N parallel parts\n"
+    "archiver -b block_size -c archive_name file1 [file2 ...] - same as -c, but splits files into independently "
+    "coded blocks of block_size bytes (K and M suffixes are allowed), so that -j N also parallelizes a single "
+    "file. Blocks that Huffman coding would not shrink noticeably are stored as is\n"
+    "archiver -s group_size -c archive_name file1 [file2 ...] - same as -b, but packs consecutive files smaller "
+    "than group_size bytes (K and M suffixes are allowed) into solid groups of up to group_size bytes that share "
+    "code tables, which saves space and time on many small files\n"
+    "archiver -a archive_name file1 [file2 ...] - append files (or directories) to the block archive "
+    "archive_name without recompressing the files already in it, creating it if it does not exist. The block "
+    "size of the archive is kept, other options work as with -c; the newest copy of a file name wins on -d "
+    "and -x\n"
+    "archiver -m adaptive -c archive_name file1 [file2 ...] - same as -c, but codes every file in one pass with "
+    "adaptive Huffman codes, so no code table is stored and the output follows the input symbol by symbol "
+    "(-m static selects the default two-pass coding)\n"
+    "archiver -L N -c archive_name file1 [file2 ...] - same as -c, but limits Huffman codes to N bits "
+    "(9 to 57), which bounds the size of decoding tables. Block archives use 15 bits by default, the default "
+    "format is not limited\n"
+    "archiver --stats -c archive_name file1 [file2 ...] - same as -c, but also prints a tab-separated report "
+    "with bytes in and out, bits per symbol against the entropy of the input, code table size, time spent "
+    "reading, counting, building codes, encoding and writing, and throughput for every file and in total "
+    "(--stats=json prints the same report as JSON). --stats goes before the other options\n"
+    "archiver -c - file1 [file2 ...] - write the archive to standard output; a file named - reads standard input "
+    "(stored as \"stdin\"). Standard input, pipes and other non-regular files are compressed in one pass using "
+    "the block format\n"
     "archiver -d archive_name - unarchive files from archive archive_name and put them in current "
-    "directory\n"
+    "directory (archive_name - reads the archive from standard input)\n"
+    "archiver -j N -d archive_name - same as -d, but decodes up to N blocks of a block archive in parallel\n"
+    "archiver -l archive_name - list files stored in archive_name with their original and compressed sizes\n"
+    "archiver -x archive_name file1 [file2 ...] - unarchive only files file1, file2, ... from archive_name\n"
+    "-l and -x read the index of block archives and seek straight to the files. The default format has no "
+    "index, so for it they decode the whole archive and print a note about it to standard error\n"
+    "archiver -d archive_name -o - (or -x archive_name -o - file1 [file2 ...]) - write the contents of the "
+    "unarchived files one after another to standard output instead of creating files; memory use depends on "
+    "the block size and -j, not on file sizes\n"
+    "archiver -t archive_name - decode every file of archive_name without writing anything and verify the "
+    "CRC-32C checksums of block archives (-j N decodes blocks in parallel). The default format has no "
+    "checksums, so only its structure is checked\n"
     "archiver -h - provides information how to work with programm\n";
 
 const std::string_view INVALID_INPUT_STR = "Invalid command line input! Run -h command to see commands.\n";
 
 namespace compressor {
 
-void CompressFile(std::string_view filepath, bool is_last_file, Stream &writer);
+struct CompressOptions {
+    size_t threads = 1;
+    size_t block_size = 0;
+    bool adaptive = false;
+    size_t max_code_length = 0;
+    size_t solid_size = 0;
+};
+
+struct EncodedFile {
+    std::vector<char> data;
+    size_t bits_count = 0;
+    MemberStats stats;
+};
+
+struct BlockBuffers {
+    std::vector<char> payload;
+    std::array<std::vector<char>, INTERLEAVED_STREAMS_COUNT> streams;
+    HaffmanTree tree;
+};
+
+struct EncodedBlock {
+    std::vector<char> data;
+    MemberStats stats;
+};
+
+template <typename F>
+void ForEachChunk(Stream &reader, F &&callback) {
+    std::optional<std::span<const char>> contiguous_data = reader.GetContiguousData();
+    if (contiguous_data.has_value()) {
+        callback(contiguous_data.value());
+        return;
+    }
+    std::vector<char> chunk(READ_CHUNK_SIZE);
+    while (size_t chunk_size = reader.ReadBytes(chunk.data(), chunk.size())) {
+        callback(std::span<const char>(chunk.data(), chunk_size));
+    }
+}
+
+void WriteTableHeader(const std::vector<std::pair<size_t, size_t>> &kanonic_order, Stream &writer);
+
+MemberStats CompressFile(std::string_view filepath, bool is_last_file, Stream &writer,
+                         const CompressOptions &options = {}, ThreadPool *pool = nullptr);
+
+EncodedFile EncodeFile(std::string_view filepath, bool is_last_file, const CompressOptions &options = {});
+
+size_t EstimateEncodedBits(const HaffmanTree::Frequencies &counts, HaffmanTree &tree);
 
-void Compress(const std::vector<std::string_view> &filenames, std::string_view archive_name);
+std::vector<char> EncodeBlock(std::span<const char> block, const CompressOptions &options = {},
+                              MemberStats *stats = nullptr);
+
+void EncodeBlock(std::span<const char> block, Stream &writer, BlockBuffers &buffers, const CompressOptions &options = {},
+                 MemberStats *stats = nullptr);
+
+size_t EncodeAdaptive(Stream &reader, Stream &writer, Crc32c &checksum);
+
+CompressStats CompressMembers(const std::vector<std::string_view> &filenames,
+                              const std::vector<std::string_view> &skipped_paths, Stream &writer, ArchiveIndex &index,
+                              const CompressOptions &options, size_t format_version);
+
+CompressStats CompressBlocks(const std::vector<std::string_view> &filenames, std::string_view archive_name,
+                             const CompressOptions &options);
+
+CompressStats Append(const std::vector<std::string_view> &filenames, std::string_view archive_name,
+                     const CompressOptions &options = {});
+
+bool NeedsStreaming(const std::vector<std::string_view> &filenames);
+
+CompressStats Compress(const std::vector<std::string_view> &filenames, std::string_view archive_name,
+                       const CompressOptions &options = {});
 
 }  // namespace compressor
 
 namespace decompressor {
 
+// Receives decoded data of a member in order, chunk by chunk.
+using MemberSink = std::function<void(std::span<const char>)>;
+
+struct DecompressOptions {
+    size_t threads = 1;
+    std::vector<std::string> members{};
+    // Called at the start of every extracted member instead of creating a file of that name. Members are
+    // decoded one after another, and the sink of a member is destroyed before the next member is opened.
+    std::function<MemberSink(const std::string &name)> output{};
+};
+
+struct BlockArchiveHeader {
+    size_t version = 0;
+    size_t block_size = 0;
+    bool has_checksums = false;
+    bool has_record_checksums = false;
+};
+
+// Scratch storage of DecodeBlock that is reused from block to block.
+struct BlockDecodeBuffers {
+    std::vector<std::pair<size_t, size_t>> symbols;
+    HaffmanDecoder decoder;
+};
+
 size_t ToNum(const std::vector<bool> &bin, bool is_little = true);
 
-void Decompress(std::string_view archive_name);
+std::vector<std::pair<size_t, size_t>> ReadTableHeader(Stream &reader, const std::runtime_error &wrong_format_error);
+
+void ReadTableHeader(Stream &reader, std::vector<std::pair<size_t, size_t>> &symbols,
+                     const std::runtime_error &wrong_format_error);
+
+std::vector<char> DecodeBlock(size_t block_type, std::span<const char> payload, size_t block_size,
+                              const std::runtime_error &wrong_format_error);
+
+void DecodeBlock(size_t block_type, std::span<const char> payload, std::span<char> block,
+                 const std::runtime_error &wrong_format_error);
+
+void DecodeBlock(size_t block_type, std::span<const char> payload, std::span<char> block,
+                 BlockDecodeBuffers &buffers, const std::runtime_error &wrong_format_error);
+
+size_t DecodeAdaptive(Stream &reader, const MemberSink *sink, const std::runtime_error &wrong_format_error);
+
+BlockArchiveHeader ReadBlockArchiveHeader(Stream &reader, const std::runtime_error &wrong_format_error);
+
+std::string ReadMemberName(Stream &reader, const std::runtime_error &wrong_format_error);
+
+// Checks the sizes in a block header before anything is allocated for the block: a coded block takes at
+// least one bit per byte, and a stored block is its own payload.
+void CheckBlockSizes(size_t block_type, size_t original_size, size_t payload_size, size_t block_size,
+                     const std::runtime_error &wrong_format_error);
+
+// Adds the record of a member (its name, and its size in a solid group) to its checksum, in the byte order
+// of the archive.
+void UpdateRecordChecksum(Crc32c &checksum, std::string_view name);
+
+void UpdateRecordChecksum(Crc32c &checksum, std::string_view name, size_t original_size);
+
+void VerifyChecksum(Stream &reader, const Crc32c &checksum, std::string_view member_name,
+                    const std::runtime_error &wrong_format_error);
+
+// The checksum starts from record_checksum, which holds the record of the member or solid group.
+size_t DecompressMemberBlocks(Stream &reader, const MemberSink *sink, const BlockArchiveHeader &header,
+                              const Crc32c &record_checksum, ThreadPool *pool, std::string_view member_name,
+                              const std::runtime_error &wrong_format_error);
+
+std::vector<MemberInfo> DecompressSolidGroup(Stream &reader, size_t offset, const BlockArchiveHeader &header,
+                                             ThreadPool *pool, const DecompressOptions &options, bool list_only,
+                                             const std::runtime_error &wrong_format_error);
+
+void PrepareMemberPath(const std::string &name);
+
+MemberSink OpenMember(const std::string &name, const DecompressOptions &options);
+
+bool IsSelected(std::string_view filename, const DecompressOptions &options);
+
+std::vector<MemberInfo> DecompressBlocks(Stream &reader, std::string_view archive_name,
+                                         const DecompressOptions &options, bool list_only);
+
+std::vector<MemberInfo> DecompressLegacy(Stream &reader, std::string_view archive_name,
+                                         const DecompressOptions &options, bool list_only);
+
+bool IsBlockArchive(Stream &reader);
+
+// Whether List and Extract can use the index of the archive. Archives in the default format have none, and
+// one on standard input can't be searched, so listing or extracting decodes the whole archive.
+bool HasIndex(std::string_view archive_name);
+
+std::vector<MemberInfo> DecompressArchive(Stream &reader, std::string_view archive_name,
+                                          const DecompressOptions &options);
+
+void Decompress(std::string_view archive_name, const DecompressOptions &options = {});
+
+std::vector<MemberInfo> List(std::string_view archive_name);
+
+void Extract(std::string_view archive_name, const DecompressOptions &options);
+
+std::vector<MemberInfo> Test(std::string_view archive_name, const DecompressOptions &options = {});
 
 }  // namespace decompressor
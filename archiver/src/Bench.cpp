@@ -0,0 +1,347 @@
+#include "Archiver.h"
+#include "BufferCodec.h"
+#include <chrono>
+#include <functional>
+#include <random>
+
+#ifndef ARCHIVER_TEST_DATA_DIR
+#define ARCHIVER_TEST_DATA_DIR "tests/data"
+#endif
+
+const double MIN_BENCH_SECONDS = 0.2;
+const size_t MIN_BENCH_RUNS = 3;
+const size_t SYNTHETIC_CORPUS_SIZE = 4 << 20;
+const size_t TINY_FILES_COUNT = 1000;
+const size_t TINY_FILE_SIZE = 100;
+
+struct Corpus {
+    std::string name{};
+    std::vector<std::string> names{};
+    std::vector<std::vector<char>> files{};
+    size_t size = 0;
+};
+
+struct BenchResult {
+    double seconds = 0;
+    size_t bytes = 0;
+    size_t symbols = 0;
+    size_t compressed_bytes = 0;
+};
+
+void PrintHeader() {
+    std::cout << "group,benchmark,corpus,bytes,symbols,seconds,mb_per_s,ns_per_symbol,ratio\n";
+}
+
+void PrintResult(std::string_view group, std::string_view benchmark, std::string_view corpus,
+                 const BenchResult &result) {
+    std::cout << group << "," << benchmark << "," << corpus << "," << result.bytes << "," << result.symbols << ","
+              << result.seconds << "," << (result.seconds > 0 ? result.bytes / result.seconds / 1e6 : 0) << ","
+              << (result.symbols > 0 ? result.seconds * 1e9 / result.symbols : 0) << ",";
+    if (result.compressed_bytes > 0) {
+        std::cout << static_cast<double>(result.bytes) / result.compressed_bytes;
+    }
+    std::cout << "\n";
+}
+
+// Runs body until both the minimal number of runs and the minimal time are reached and returns the
+// fastest run, which is the least disturbed by the rest of the system.
+double Measure(const std::function<void()> &body) {
+    double best = std::numeric_limits<double>::max();
+    double total = 0;
+    for (size_t runs = 0; runs < MIN_BENCH_RUNS || total < MIN_BENCH_SECONDS; ++runs) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, seconds);
+        total += seconds;
+    }
+    return best;
+}
+
+Corpus MakeSingleFileCorpus(std::string name, std::vector<char> data) {
+    Corpus corpus{.name = std::move(name), .size = data.size()};
+    corpus.names.push_back(corpus.name + ".bin");
+    corpus.files.push_back(std::move(data));
+    return corpus;
+}
+
+std::vector<Corpus> MakeSyntheticCorpora() {
+    std::mt19937_64 generator(2024);
+    std::vector<Corpus> corpora;
+
+    std::vector<char> uniform(SYNTHETIC_CORPUS_SIZE);
+    for (char &c : uniform) {
+        c = static_cast<char>(generator());
+    }
+    corpora.push_back(MakeSingleFileCorpus("uniform_random", std::move(uniform)));
+
+    std::vector<std::string> words;
+    for (size_t i = 0; i < 2000; ++i) {
+        std::string word;
+        for (size_t length = 2 + generator() % 8; length > 0; --length) {
+            word += static_cast<char>('a' + generator() % 26);
+        }
+        words.push_back(word);
+    }
+    std::vector<double> weights;
+    for (size_t i = 0; i < words.size(); ++i) {
+        weights.push_back(1.0 / (i + 1));
+    }
+    std::discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+    std::vector<char> text;
+    while (text.size() < SYNTHETIC_CORPUS_SIZE) {
+        const std::string &word = words[zipf(generator)];
+        text.insert(text.end(), word.begin(), word.end());
+        text.push_back(generator() % 12 == 0 ? '\n' : ' ');
+    }
+    corpora.push_back(MakeSingleFileCorpus("skewed_text", std::move(text)));
+
+    corpora.push_back(MakeSingleFileCorpus("one_byte", std::vector<char>(SYNTHETIC_CORPUS_SIZE, 'x')));
+
+    Corpus tiny{.name = "tiny_files"};
+    for (size_t i = 0; i < TINY_FILES_COUNT; ++i) {
+        std::vector<char> file(TINY_FILE_SIZE);
+        for (char &c : file) {
+            c = static_cast<char>('a' + generator() % 16);
+        }
+        tiny.names.push_back("tiny_" + std::to_string(i) + ".txt");
+        tiny.files.push_back(std::move(file));
+        tiny.size += TINY_FILE_SIZE;
+    }
+    corpora.push_back(std::move(tiny));
+    return corpora;
+}
+
+std::vector<Corpus> LoadTestDataCorpora(const std::filesystem::path &data_dir) {
+    std::vector<Corpus> corpora;
+    std::error_code error;
+    for (const auto &directory : std::filesystem::directory_iterator(data_dir, error)) {
+        if (!directory.is_directory()) {
+            continue;
+        }
+        Corpus corpus{.name = "data_" + directory.path().filename().string()};
+        for (const auto &entry : std::filesystem::directory_iterator(directory.path())) {
+            std::string name = entry.path().filename().string();
+            if (!entry.is_regular_file() || name.starts_with("test_")) {
+                continue;
+            }
+            Stream reader(entry.path().string(), 'r');
+            std::vector<char> data(entry.file_size());
+            data.resize(reader.ReadBytes(data.data(), data.size()));
+            corpus.size += data.size();
+            corpus.names.push_back(name);
+            corpus.files.push_back(std::move(data));
+        }
+        if (!corpus.files.empty()) {
+            corpora.push_back(std::move(corpus));
+        }
+    }
+    std::sort(corpora.begin(), corpora.end(), [](const Corpus &a, const Corpus &b) { return a.name < b.name; });
+    return corpora;
+}
+
+std::vector<char> Concatenate(const Corpus &corpus) {
+    std::vector<char> data;
+    data.reserve(corpus.size);
+    for (const std::vector<char> &file : corpus.files) {
+        data.insert(data.end(), file.begin(), file.end());
+    }
+    return data;
+}
+
+void BenchStream() {
+    const size_t codes_count = 1 << 22;
+    std::mt19937 generator(7);
+    std::vector<std::pair<uint64_t, size_t>> codes(codes_count);
+    size_t total_bits = 0;
+    for (auto &[code, length] : codes) {
+        length = 1 + generator() % 15;
+        code = generator() & ((1 << length) - 1);
+        total_bits += length;
+    }
+
+    std::vector<char> encoded;
+    BenchResult write{.bytes = total_bits / 8, .symbols = codes_count};
+    write.seconds = Measure([&] {
+        encoded.clear();
+        Stream writer(encoded);
+        for (auto &[code, length] : codes) {
+            writer.WriteBits(code, length);
+        }
+    });
+    PrintResult("stream", "write_bits", "random_codes", write);
+
+    uint64_t checksum = 0;
+    BenchResult read{.bytes = total_bits / 8, .symbols = codes_count};
+    read.seconds = Measure([&] {
+        Stream reader(std::as_bytes(std::span<const char>(encoded)));
+        for (auto &[code, length] : codes) {
+            checksum += reader.ReadUInt(length);
+        }
+    });
+    PrintResult("stream", "read_bits", "random_codes", read);
+
+    BenchResult peek{.bytes = total_bits / 8, .symbols = codes_count};
+    peek.seconds = Measure([&] {
+        Stream reader(std::as_bytes(std::span<const char>(encoded)));
+        for (auto &[code, length] : codes) {
+            checksum += reader.Peek(length);
+            reader.Consume(length);
+        }
+    });
+    PrintResult("stream", "peek_consume", "random_codes", peek);
+    if (checksum == 0) {
+        std::cerr << "unexpected checksum\n";
+    }
+}
+
+void BenchCoding(const Corpus &corpus) {
+    std::vector<char> data = Concatenate(corpus);
+
+    Histogram histogram;
+    BenchResult counting{.bytes = data.size(), .symbols = data.size()};
+    counting.seconds = Measure([&] {
+        histogram = Histogram();
+        histogram.Add(data);
+    });
+    PrintResult("histogram", "count", corpus.name, counting);
+    if (data.empty()) {
+        return;
+    }
+
+    size_t symbols_count = 0;
+    for (size_t count : histogram.GetCounts()) {
+        symbols_count += count > 0;
+    }
+    const size_t tree_runs = 1000;
+    BenchResult tree{.symbols = symbols_count * tree_runs};
+    tree.seconds = Measure([&] {
+        for (size_t i = 0; i < tree_runs; ++i) {
+            HaffmanTree haffman_tree(histogram.GetCounts(), HaffmanTree::DEFAULT_MAX_CODE_LENGTH);
+        }
+    });
+    PrintResult("tree", "build", corpus.name, tree);
+
+    HaffmanTree haffman_tree(histogram.GetCounts(), HaffmanTree::DEFAULT_MAX_CODE_LENGTH);
+    BenchResult code_table{.symbols = symbols_count * tree_runs};
+    code_table.seconds = Measure([&] {
+        for (size_t i = 0; i < tree_runs; ++i) {
+            HaffmanDecoder::BuildCodeTable(haffman_tree.GetHaffmanCodes());
+        }
+    });
+    PrintResult("code_table", "build", corpus.name, code_table);
+
+    BenchResult decoder{.symbols = symbols_count * tree_runs};
+    decoder.seconds = Measure([&] {
+        for (size_t i = 0; i < tree_runs; ++i) {
+            HaffmanTree::RestoreKanonicCodes(haffman_tree.GetHaffmanCodes());
+        }
+    });
+    PrintResult("code_table", "restore_decoder", corpus.name, decoder);
+
+    std::span<const char> block = std::span<const char>(data).first(std::min(data.size(), DEFAULT_BLOCK_SIZE));
+    std::vector<char> encoded;
+    BenchResult encode{.bytes = block.size(), .symbols = block.size()};
+    encode.seconds = Measure([&] { encoded = compressor::EncodeBlock(block); });
+    encode.compressed_bytes = encoded.size();
+    PrintResult("block", "encode", corpus.name, encode);
+
+    size_t block_type = static_cast<unsigned char>(encoded[0]);
+    std::span<const char> payload = std::span<const char>(encoded).subspan(9);
+    auto wrong_format_error = std::runtime_error("Benchmark block has wrong format!");
+    BenchResult decode{.bytes = block.size(), .symbols = block.size(), .compressed_bytes = encoded.size()};
+    decode.seconds = Measure([&] { decompressor::DecodeBlock(block_type, payload, block.size(), wrong_format_error); });
+    PrintResult("block", "decode", corpus.name, decode);
+
+    Crc32c crc;
+    BenchResult checksum{.bytes = block.size(), .symbols = block.size()};
+    checksum.seconds = Measure([&] {
+        crc = Crc32c();
+        crc.Update(block);
+    });
+    PrintResult("checksum", Crc32c::HasHardwareSupport() ? "crc32c_sse42" : "crc32c_table", corpus.name, checksum);
+
+    std::span<const std::byte> buffer = std::as_bytes(block);
+    std::vector<std::byte> compressed;
+    std::vector<std::byte> restored;
+    BenchResult buffer_fresh{.bytes = block.size(), .symbols = block.size()};
+    buffer_fresh.seconds = Measure([&] {
+        BufferCodec codec;
+        codec.Compress(buffer, compressed);
+        codec.Decompress(compressed, restored);
+    });
+    buffer_fresh.compressed_bytes = compressed.size();
+    PrintResult("buffer", "roundtrip_new_codec", corpus.name, buffer_fresh);
+
+    BufferCodec codec;
+    BenchResult buffer_reused = buffer_fresh;
+    buffer_reused.seconds = Measure([&] {
+        codec.Compress(buffer, compressed);
+        codec.Decompress(compressed, restored);
+    });
+    PrintResult("buffer", "roundtrip_reused_codec", corpus.name, buffer_reused);
+}
+
+void BenchEndToEnd(const Corpus &corpus, const std::filesystem::path &work_dir) {
+    std::filesystem::path input_dir = work_dir / "input";
+    std::filesystem::path output_dir = work_dir / "output";
+    std::filesystem::remove_all(work_dir);
+    std::filesystem::create_directories(input_dir);
+    std::filesystem::create_directories(output_dir);
+
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < corpus.files.size(); ++i) {
+        paths.push_back((input_dir / corpus.names[i]).string());
+        Stream writer(paths.back(), 'w');
+        writer.WriteBytes(corpus.files[i].data(), corpus.files[i].size());
+    }
+    std::vector<std::string_view> filenames(paths.begin(), paths.end());
+    std::string archive_name = (work_dir / "archive.arc").string();
+
+    std::vector<std::pair<std::string_view, compressor::CompressOptions>> modes = {
+        {"default", {}},
+        {"blocks", {.block_size = DEFAULT_BLOCK_SIZE}},
+        {"blocks_parallel", {.threads = 0, .block_size = DEFAULT_BLOCK_SIZE}},
+        {"adaptive", {.adaptive = true}},
+    };
+    std::filesystem::path initial_dir = std::filesystem::current_path();
+    for (auto &[mode, options] : modes) {
+        BenchResult compress{.bytes = corpus.size, .symbols = corpus.size};
+        compress.seconds = Measure([&] { compressor::Compress(filenames, archive_name, options); });
+        compress.compressed_bytes = std::filesystem::file_size(archive_name);
+        PrintResult("end_to_end", std::string("compress_") + std::string(mode), corpus.name, compress);
+
+        BenchResult decompress = compress;
+        std::filesystem::current_path(output_dir);
+        decompress.seconds = Measure([&] { decompressor::Decompress(archive_name, {.threads = options.threads}); });
+        std::filesystem::current_path(initial_dir);
+        PrintResult("end_to_end", std::string("decompress_") + std::string(mode), corpus.name, decompress);
+
+        BenchResult test = compress;
+        test.seconds = Measure([&] { decompressor::Test(archive_name, {.threads = options.threads}); });
+        PrintResult("end_to_end", std::string("test_") + std::string(mode), corpus.name, test);
+    }
+    std::filesystem::remove_all(work_dir);
+}
+
+int main(int argc, char **argv) {
+    std::filesystem::path data_dir = argc > 1 ? argv[1] : ARCHIVER_TEST_DATA_DIR;
+    std::filesystem::path work_dir = std::filesystem::temp_directory_path() / "bench_archiver";
+    try {
+        std::vector<Corpus> corpora = MakeSyntheticCorpora();
+        for (Corpus &corpus : LoadTestDataCorpora(data_dir)) {
+            corpora.push_back(std::move(corpus));
+        }
+
+        PrintHeader();
+        BenchStream();
+        for (const Corpus &corpus : corpora) {
+            BenchCoding(corpus);
+            BenchEndToEnd(corpus, work_dir);
+        }
+    } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << "\n";
+        return ERROR_CODE;
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "BufferCodec.h"
+
+namespace {
+
+const std::runtime_error WRONG_BUFFER_FORMAT_ERROR("Buffer has wrong compressed data format!");
+
+std::span<const char> AsChars(std::span<const std::byte> data) {
+    return {reinterpret_cast<const char *>(data.data()), data.size()};
+}
+
+}  // namespace
+
+BufferCodec::BufferCodec(const compressor::CompressOptions &options) : options_(options) {
+    if (options_.block_size == 0) {
+        options_.block_size = DEFAULT_BLOCK_SIZE;
+    }
+    if (options_.block_size > MAX_BLOCK_SIZE) {
+        throw std::runtime_error("Block size must be between 1 and " + std::to_string(MAX_BLOCK_SIZE) + " bytes!");
+    }
+    if (options_.adaptive) {
+        throw std::runtime_error("Adaptive coding is not supported for buffers!");
+    }
+}
+
+size_t BufferCodec::MaxCompressedSize(size_t input_size, size_t block_size) {
+    // Blocks that coding does not shrink are stored, so no block grows by more than its header.
+    size_t blocks_count = (input_size + block_size - 1) / block_size;
+    return FRAME_HEADER_SIZE + blocks_count * BLOCK_HEADER_SIZE + input_size + 1 + CHECKSUM_SIZE;
+}
+
+size_t BufferCodec::Encode(std::span<const std::byte> input, std::span<std::byte> output) {
+    Stream writer(output);
+    writer.WriteNumber(0, 16);
+    writer.WriteNumber(FORMAT_MAGIC, 16);
+    writer.WriteNumber(BLOCK_FORMAT_VERSION, 8);
+    writer.WriteNumber(options_.block_size, 32);
+    std::span<const char> data = AsChars(input);
+    Crc32c checksum;
+    checksum.Update(data);
+    for (size_t position = 0; position < data.size(); position += options_.block_size) {
+        compressor::EncodeBlock(data.subspan(position, std::min(options_.block_size, data.size() - position)),
+                                writer, block_buffers_, options_);
+    }
+    writer.WriteNumber(BLOCK_END, 8);
+    writer.WriteNumber(checksum.GetValue(), 32);
+    return writer.BitsWritten() / 8;
+}
+
+size_t BufferCodec::Compress(std::span<const std::byte> input, std::vector<std::byte> &output) {
+    output.resize(MaxCompressedSize(input.size(), options_.block_size));
+    output.resize(Encode(input, output));
+    return output.size();
+}
+
+size_t BufferCodec::Compress(std::span<const std::byte> input, std::span<std::byte> output) {
+    if (output.size() < MaxCompressedSize(input.size(), options_.block_size)) {
+        throw std::runtime_error("Output buffer is too small for compressed data!");
+    }
+    return Encode(input, output);
+}
+
+template <typename F>
+size_t BufferCodec::ForEachBlock(std::span<const std::byte> input, F &&callback, const Crc32c *checksum) {
+    Stream reader(input);
+    decompressor::BlockArchiveHeader header = decompressor::ReadBlockArchiveHeader(reader, WRONG_BUFFER_FORMAT_ERROR);
+    size_t block_size = header.block_size;
+    size_t total_size = 0;
+    while (true) {
+        if (reader.Eof()) {
+            throw WRONG_BUFFER_FORMAT_ERROR;
+        }
+        size_t block_type = reader.ReadUInt(8);
+        if (block_type == BLOCK_END) {
+            break;
+        }
+        if (block_type != BLOCK_HAFFMAN && block_type != BLOCK_HAFFMAN_INTERLEAVED && block_type != BLOCK_STORED) {
+            throw WRONG_BUFFER_FORMAT_ERROR;
+        }
+        size_t original_size = reader.ReadUInt(32);
+        size_t payload_size = reader.ReadUInt(32);
+        decompressor::CheckBlockSizes(block_type, original_size, payload_size, block_size, WRONG_BUFFER_FORMAT_ERROR);
+        if (payload_size > input.size() - reader.Tell()) {
+            throw WRONG_BUFFER_FORMAT_ERROR;
+        }
+        callback(block_type, AsChars(input.subspan(reader.Tell(), payload_size)), total_size, original_size);
+        reader.Seek(reader.Tell() + payload_size);
+        total_size += original_size;
+    }
+    if (header.has_checksums && checksum) {
+        decompressor::VerifyChecksum(reader, *checksum, "buffer", WRONG_BUFFER_FORMAT_ERROR);
+    }
+    return total_size;
+}
+
+size_t BufferCodec::GetDecompressedSize(std::span<const std::byte> input) {
+    return ForEachBlock(input, [](size_t, std::span<const char>, size_t, size_t) {}, nullptr);
+}
+
+size_t BufferCodec::Decompress(std::span<const std::byte> input, std::vector<std::byte> &output) {
+    output.resize(GetDecompressedSize(input));
+    return Decompress(input, std::span<std::byte>(output));
+}
+
+size_t BufferCodec::Decompress(std::span<const std::byte> input, std::span<std::byte> output) {
+    std::span<char> data(reinterpret_cast<char *>(output.data()), output.size());
+    Crc32c checksum;
+    auto decode_block = [this, data, &checksum](size_t block_type, std::span<const char> payload, size_t offset,
+                                            size_t original_size) {
+        if (original_size > data.size() - std::min(offset, data.size())) {
+            throw std::runtime_error("Output buffer is too small for decompressed data!");
+        }
+        decompressor::DecodeBlock(block_type, payload, data.subspan(offset, original_size), decode_buffers_,
+                                  WRONG_BUFFER_FORMAT_ERROR);
+        checksum.Update(data.subspan(offset, original_size));
+    };
+    return ForEachBlock(input, decode_block, &checksum);
+}
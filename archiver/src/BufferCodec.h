@@ -0,0 +1,40 @@
+#pragma once
+#include "Archiver.h"
+
+// Compresses memory buffers with the block coder of the archiver. A compressed buffer is a frame of
+// the block format: the archive header, the blocks of one member, BLOCK_END and the CRC-32C of the
+// input, which Decompress verifies. The frame is written straight into the output, and the codec keeps
+// the scratch buffers of the coder and the decoder: after the first call, Compress and Decompress into
+// caller spans of blocks no larger than before do not allocate.
+class BufferCodec {
+private:
+    compressor::CompressOptions options_;
+    compressor::BlockBuffers block_buffers_;
+    decompressor::BlockDecodeBuffers decode_buffers_;
+
+    size_t Encode(std::span<const std::byte> input, std::span<std::byte> output);
+
+    template <typename F>
+    static size_t ForEachBlock(std::span<const std::byte> input, F &&callback, const Crc32c *checksum);
+
+public:
+    static constexpr size_t FRAME_HEADER_SIZE = 9;
+    static constexpr size_t BLOCK_HEADER_SIZE = 9;
+    static constexpr size_t CHECKSUM_SIZE = 4;
+
+    explicit BufferCodec(const compressor::CompressOptions &options = {});
+
+    static size_t MaxCompressedSize(size_t input_size, size_t block_size = DEFAULT_BLOCK_SIZE);
+
+    static size_t GetDecompressedSize(std::span<const std::byte> input);
+
+    size_t Compress(std::span<const std::byte> input, std::vector<std::byte> &output);
+
+    // The output must hold MaxCompressedSize(input.size(), block_size) bytes; this is checked before
+    // anything is encoded.
+    size_t Compress(std::span<const std::byte> input, std::span<std::byte> output);
+
+    size_t Decompress(std::span<const std::byte> input, std::vector<std::byte> &output);
+
+    size_t Decompress(std::span<const std::byte> input, std::span<std::byte> output);
+};
@@ -0,0 +1,133 @@
+#include "CompressStats.h"
+#include <cmath>
+#include <iomanip>
+
+PhaseTimes &PhaseTimes::operator+=(const PhaseTimes &other) {
+    read += other.read;
+    histogram += other.histogram;
+    tree += other.tree;
+    encode += other.encode;
+    write += other.write;
+    return *this;
+}
+
+double PhaseTimes::Total() const {
+    return read + histogram + tree + encode + write;
+}
+
+void MemberStats::AddEntropy(const HaffmanTree::Frequencies &counts) {
+    size_t total = 0;
+    for (size_t count : counts) {
+        total += count;
+    }
+    for (size_t count : counts) {
+        if (count > 0) {
+            entropy_bits -= static_cast<double>(count) * std::log2(static_cast<double>(count) / total);
+        }
+    }
+    entropy_symbols += total;
+}
+
+MemberStats &MemberStats::operator+=(const MemberStats &other) {
+    bytes_in += other.bytes_in;
+    bits_out += other.bits_out;
+    table_bits += other.table_bits;
+    entropy_symbols += other.entropy_symbols;
+    entropy_bits += other.entropy_bits;
+    times += other.times;
+    return *this;
+}
+
+void CompressStats::AddMember(MemberStats member) {
+    members_.push_back(std::move(member));
+}
+
+void CompressStats::SetWallSeconds(double wall_seconds) {
+    wall_seconds_ = wall_seconds;
+}
+
+const std::vector<MemberStats> &CompressStats::GetMembers() const {
+    return members_;
+}
+
+MemberStats CompressStats::GetTotal() const {
+    MemberStats total{.name = "total"};
+    for (const MemberStats &member : members_) {
+        total += member;
+    }
+    return total;
+}
+
+void CompressStats::PrintText(std::ostream &out, const MemberStats &member, double total_seconds) {
+    out << member.name << "\t" << member.bytes_in << "\t" << (member.bits_out + 7) / 8 << "\t";
+    if (member.bytes_in > 0) {
+        out << static_cast<double>(member.bits_out) / member.bytes_in;
+    } else {
+        out << "-";
+    }
+    out << "\t";
+    if (member.entropy_symbols > 0) {
+        out << member.entropy_bits / member.entropy_symbols;
+    } else {
+        out << "-";
+    }
+    out << "\t" << (member.table_bits + 7) / 8;
+    for (double seconds : {member.times.read, member.times.histogram, member.times.tree, member.times.encode,
+                           member.times.write, total_seconds}) {
+        out << "\t" << seconds * 1e3;
+    }
+    out << "\t" << (total_seconds > 0 ? member.bytes_in / total_seconds / 1e6 : 0) << "\n";
+}
+
+void CompressStats::PrintJson(std::ostream &out, const MemberStats &member, double total_seconds) {
+    out << "{\"name\": \"";
+    for (char c : member.name) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec
+                << std::setfill(' ');
+        } else {
+            out << c;
+        }
+    }
+    out << "\", \"bytes_in\": " << member.bytes_in << ", \"bytes_out\": " << (member.bits_out + 7) / 8
+        << ", \"bits_per_symbol\": ";
+    if (member.bytes_in > 0) {
+        out << static_cast<double>(member.bits_out) / member.bytes_in;
+    } else {
+        out << "null";
+    }
+    out << ", \"entropy_bits_per_symbol\": ";
+    if (member.entropy_symbols > 0) {
+        out << member.entropy_bits / member.entropy_symbols;
+    } else {
+        out << "null";
+    }
+    out << ", \"table_bytes\": " << (member.table_bits + 7) / 8 << ", \"seconds\": {\"read\": " << member.times.read
+        << ", \"histogram\": " << member.times.histogram << ", \"tree\": " << member.times.tree
+        << ", \"encode\": " << member.times.encode << ", \"write\": " << member.times.write
+        << ", \"total\": " << total_seconds << "}, \"mb_per_s\": "
+        << (total_seconds > 0 ? member.bytes_in / total_seconds / 1e6 : 0) << "}";
+}
+
+void CompressStats::Print(std::ostream &out, bool is_json) const {
+    MemberStats total = GetTotal();
+    if (is_json) {
+        out << "{\"files\": [";
+        for (size_t i = 0; i < members_.size(); ++i) {
+            out << (i > 0 ? ", " : "");
+            PrintJson(out, members_[i], members_[i].times.Total());
+        }
+        out << "], \"total\": ";
+        PrintJson(out, total, wall_seconds_);
+        out << "}\n";
+        return;
+    }
+    out << "file\tbytes_in\tbytes_out\tbits_per_symbol\tentropy\ttable_bytes\tread_ms\thistogram_ms\ttree_ms"
+           "\tencode_ms\twrite_ms\ttotal_ms\tmb_per_s\n";
+    for (const MemberStats &member : members_) {
+        PrintText(out, member, member.times.Total());
+    }
+    PrintText(out, total, wall_seconds_);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "HaffmanTree.h"
+
+class Stopwatch {
+private:
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+
+public:
+    double Lap() {
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - start_).count();
+        start_ = now;
+        return seconds;
+    }
+};
+
+struct PhaseTimes {
+    double read = 0;
+    double histogram = 0;
+    double tree = 0;
+    double encode = 0;
+    double write = 0;
+
+    PhaseTimes &operator+=(const PhaseTimes &other);
+
+    double Total() const;
+};
+
+struct MemberStats {
+    std::string name{};
+    size_t bytes_in = 0;
+    size_t bits_out = 0;
+    size_t table_bits = 0;
+    size_t entropy_symbols = 0;
+    double entropy_bits = 0;
+    PhaseTimes times{};
+
+    void AddEntropy(const HaffmanTree::Frequencies &counts);
+
+    MemberStats &operator+=(const MemberStats &other);
+};
+
+class CompressStats {
+private:
+    std::vector<MemberStats> members_;
+    double wall_seconds_ = 0;
+
+    static void PrintText(std::ostream &out, const MemberStats &member, double total_seconds);
+
+    static void PrintJson(std::ostream &out, const MemberStats &member, double total_seconds);
+
+public:
+    void AddMember(MemberStats member);
+
+    void SetWallSeconds(double wall_seconds);
+
+    const std::vector<MemberStats> &GetMembers() const;
+
+    MemberStats GetTotal() const;
+
+    void Print(std::ostream &out, bool is_json) const;
+};
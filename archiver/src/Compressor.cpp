@@ -1,89 +1,548 @@
 #include "Archiver.h"
 
-void compressor::CompressFile(std::string_view filepath, bool is_last_file, Stream &writer) {
+void compressor::WriteTableHeader(const std::vector<std::pair<size_t, size_t>> &kanonic_order, Stream &writer) {
+    writer.WriteNumber(kanonic_order.size(), BYTE_SIZE);
+
+    std::array<size_t, HaffmanDecoder::MAX_CODE_LENGTH> symbol_code_sizes{};
+    size_t max_length = 1;
+    for (auto &[char_num, length] : kanonic_order) {
+        writer.WriteNumber(char_num, BYTE_SIZE);
+        ++symbol_code_sizes.at(length - 1);
+        max_length = std::max(max_length, length);
+    }
+
+    for (size_t length = 0; length < max_length; ++length) {
+        writer.WriteNumber(symbol_code_sizes[length], BYTE_SIZE);
+    }
+}
+
+MemberStats compressor::CompressFile(std::string_view filepath, bool is_last_file, Stream &writer,
+                                     const CompressOptions &options, ThreadPool *pool) {
+    Stopwatch stopwatch;
+    size_t start_bits = writer.BitsWritten();
     Stream reader(filepath, 'r');
 
-    size_t slash_index = filepath.rfind('/');
-    std::string_view filename = filepath.substr(slash_index == std::string_view::npos ? 0 : slash_index + 1);
+    std::string_view filename = GetFilename(filepath);
+    MemberStats stats{.name = std::string(filename)};
+    stats.times.read += stopwatch.Lap();
+
+    Histogram histogram;
+    ForEachChunk(reader, [&histogram, &stats, &stopwatch, pool](std::span<const char> chunk) {
+        stats.times.read += stopwatch.Lap();
+        histogram.Add(chunk, pool);
+        stats.bytes_in += chunk.size();
+        stats.times.histogram += stopwatch.Lap();
+    });
+    stats.AddEntropy(histogram.GetCounts());
+    histogram.Add(filename);
+    histogram.Add(FILENAME_END);
+    histogram.Add(ONE_MORE_FILE);
+    histogram.Add(ARCHIVE_END);
+
+    reader.ResetStream();
+    stats.times.histogram += stopwatch.Lap();
+
+    HaffmanTree tree(histogram.GetCounts(),
+                     options.max_code_length ? options.max_code_length : HaffmanDecoder::MAX_CODE_LENGTH);
+    const HaffmanTree::CodeTable &code_table = tree.GetCodeTable();
+    size_t table_start_bits = writer.BitsWritten();
+    WriteTableHeader(tree.GetHaffmanCodes(), writer);
+    stats.table_bits = writer.BitsWritten() - table_start_bits;
+    stats.times.tree += stopwatch.Lap();
 
-    std::unordered_map<size_t, size_t> counts;
     for (unsigned char c : filename) {
-        ++counts[c];
+        auto [code, length] = code_table[c];
+        if (length == 0) {
+            throw std::runtime_error("Kanonic code for symbol " + std::to_string(c) + " not found!");
+        }
+        writer.WriteBits(code, length);
+    }
+    if (code_table[FILENAME_END].length == 0) {
+        throw std::runtime_error("Kanonic code for symbol FILENAME_END not found");
     }
+    writer.WriteBits(code_table[FILENAME_END].code, code_table[FILENAME_END].length);
+
+    ForEachChunk(reader, [&code_table, &writer, &stats, &stopwatch](std::span<const char> chunk) {
+        stats.times.read += stopwatch.Lap();
+        for (char c : chunk) {
+            unsigned char current_char = static_cast<unsigned char>(c);
+            auto [code, length] = code_table[current_char];
+            if (length == 0) {
+                throw std::runtime_error("Kanonic code for symbol " + std::to_string(current_char) + " not found!");
+            }
+            writer.WriteBits(code, length);
+        }
+        stats.times.encode += stopwatch.Lap();
+    });
 
-    while (!reader.Eof()) {
-        unsigned char current_char = reader.ReadChar();
-        ++counts[current_char];
+    size_t end_symbol = is_last_file ? ARCHIVE_END : ONE_MORE_FILE;
+    if (code_table[end_symbol].length == 0) {
+        throw std::runtime_error(is_last_file ? "Kanonic code for symbol ARCHIVE_END not found"
+                                              : "Kanonic code for symbol ONE_MORE_FILE not found");
     }
+    writer.WriteBits(code_table[end_symbol].code, code_table[end_symbol].length);
+    stats.bits_out = writer.BitsWritten() - start_bits;
+    stats.times.encode += stopwatch.Lap();
+    return stats;
+}
 
-    counts[FILENAME_END] = 1;
-    counts[ONE_MORE_FILE] = 1;
-    counts[ARCHIVE_END] = 1;
+compressor::EncodedFile compressor::EncodeFile(std::string_view filepath, bool is_last_file,
+                                               const CompressOptions &options) {
+    EncodedFile encoded;
+    {
+        Stream writer(encoded.data);
+        encoded.stats = CompressFile(filepath, is_last_file, writer, options);
+        encoded.bits_count = writer.BitsWritten();
+    }
+    return encoded;
+}
 
-    reader.ResetStream();
+bool compressor::NeedsStreaming(const std::vector<std::string_view> &filenames) {
+    for (std::string_view filepath : filenames) {
+        std::error_code error;
+        if (filepath == Stream::STANDARD_STREAM_NAME || !std::filesystem::is_regular_file(filepath, error)) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    HaffmanTree tree(counts);
-    std::unordered_map<size_t, std::vector<bool>> kanonic_codes = tree.GetKanonicCodes();
-    std::vector<std::pair<size_t, size_t>> kanonic_order = tree.GetHaffmanCodes();
+CompressStats compressor::Compress(const std::vector<std::string_view> &filenames, std::string_view archive_name,
+                                   const CompressOptions &options) {
+    if (options.block_size > 0) {
+        return CompressBlocks(filenames, archive_name, options);
+    }
+    if (options.adaptive || options.solid_size > 0 || NeedsStreaming(filenames)) {
+        CompressOptions streaming_options = options;
+        streaming_options.block_size = DEFAULT_BLOCK_SIZE;
+        return CompressBlocks(filenames, archive_name, streaming_options);
+    }
 
-    writer.WriteNumber(kanonic_order.size(), BYTE_SIZE);
+    Stopwatch wall;
+    CompressStats stats;
+    Stream writer(archive_name, 'w');
 
-    std::vector<size_t> symbol_code_sizes = {0};
-    for (auto &[char_num, length] : kanonic_order) {
-        writer.WriteNumber(char_num, BYTE_SIZE);
-        while (length != symbol_code_sizes.size()) {
-            symbol_code_sizes.push_back(0);
+    if (options.threads == 1 || filenames.size() < 2) {
+        std::unique_ptr<ThreadPool> pool;
+        if (options.threads != 1) {
+            pool = std::make_unique<ThreadPool>(options.threads);
+        }
+        for (size_t i = 0; i < filenames.size(); ++i) {
+            bool is_last_file = (i + 1) == filenames.size();
+            stats.AddMember(CompressFile(filenames[i], is_last_file, writer, options, pool.get()));
         }
-        ++symbol_code_sizes.back();
+        stats.SetWallSeconds(wall.Lap());
+        return stats;
     }
 
-    for (auto &cnt : symbol_code_sizes) {
-        writer.WriteNumber(cnt, BYTE_SIZE);
+    ThreadPool pool(options.threads);
+    std::deque<std::future<EncodedFile>> in_flight;
+    size_t next_file = 0;
+    for (size_t i = 0; i < filenames.size(); ++i) {
+        for (; next_file < filenames.size() && next_file < i + 2 * pool.Size(); ++next_file) {
+            std::string_view filepath = filenames[next_file];
+            bool is_last_file = (next_file + 1) == filenames.size();
+            in_flight.push_back(pool.Submit(
+                [filepath, is_last_file, &options] { return EncodeFile(filepath, is_last_file, options); }));
+        }
+        EncodedFile encoded = in_flight.front().get();
+        in_flight.pop_front();
+        Stopwatch stopwatch;
+        writer.AppendBits(encoded.data, encoded.bits_count);
+        encoded.stats.times.write += stopwatch.Lap();
+        stats.AddMember(std::move(encoded.stats));
     }
+    stats.SetWallSeconds(wall.Lap());
+    return stats;
+}
 
-    for (unsigned char c : filename) {
-        auto code_iter = kanonic_codes.find(c);
-        if (code_iter == kanonic_codes.end()) {
-            throw std::runtime_error(std::string("Kanonic code for symbol") + reinterpret_cast<const char *>(c) +
-                                     std::string("not found!"));
+size_t compressor::EstimateEncodedBits(const HaffmanTree::Frequencies &counts, HaffmanTree &tree) {
+    const std::vector<std::pair<size_t, size_t>> &codes = tree.GetHaffmanCodes();
+    size_t bits_count = BYTE_SIZE * (codes.size() + codes.back().second + 1);
+    for (auto [char_num, length] : codes) {
+        bits_count += counts[char_num] * length;
+    }
+    return bits_count;
+}
+
+std::vector<char> compressor::EncodeBlock(std::span<const char> block, const CompressOptions &options,
+                                          MemberStats *stats) {
+    std::vector<char> encoded;
+    BlockBuffers buffers;
+    {
+        Stream writer(encoded);
+        EncodeBlock(block, writer, buffers, options, stats);
+    }
+    return encoded;
+}
+
+void compressor::EncodeBlock(std::span<const char> block, Stream &writer, BlockBuffers &buffers,
+                             const CompressOptions &options, MemberStats *stats) {
+    Stopwatch stopwatch;
+    MemberStats block_stats{.bytes_in = block.size()};
+    Histogram histogram;
+    histogram.Add(block);
+    block_stats.AddEntropy(histogram.GetCounts());
+    block_stats.times.histogram += stopwatch.Lap();
+
+    HaffmanTree &tree = buffers.tree;
+    tree.Build(histogram.GetCounts(),
+               options.max_code_length ? options.max_code_length : HaffmanTree::DEFAULT_MAX_CODE_LENGTH);
+    const HaffmanTree::CodeTable &code_table = tree.GetCodeTable();
+    block_stats.times.tree += stopwatch.Lap();
+
+    auto encode_symbols = [&code_table](std::span<const char> symbols, Stream &writer) {
+        for (char c : symbols) {
+            auto [code, length] = code_table[static_cast<unsigned char>(c)];
+            writer.WriteBits(code, length);
         }
-        writer.Write(code_iter->second);
+    };
+
+    size_t block_type = BLOCK_STORED;
+    std::vector<char> &payload = buffers.payload;
+    payload.clear();
+    if (EstimateEncodedBits(histogram.GetCounts(), tree) / 8 < block.size() - block.size() / MIN_SAVINGS_RATIO) {
+        block_type = block.size() >= MIN_INTERLEAVED_BLOCK_SIZE ? BLOCK_HAFFMAN_INTERLEAVED : BLOCK_HAFFMAN;
     }
-    if (!kanonic_codes.contains(FILENAME_END)) {
-        throw std::runtime_error("Kanonic code for symbol FILENAME_END not found");
+    if (block_type == BLOCK_HAFFMAN_INTERLEAVED) {
+        size_t segment_size = (block.size() + INTERLEAVED_STREAMS_COUNT - 1) / INTERLEAVED_STREAMS_COUNT;
+        std::array<std::vector<char>, INTERLEAVED_STREAMS_COUNT> &streams = buffers.streams;
+        for (size_t i = 0; i < streams.size(); ++i) {
+            size_t offset = std::min(i * segment_size, block.size());
+            streams[i].clear();
+            Stream stream_writer(streams[i]);
+            encode_symbols(block.subspan(offset, std::min(segment_size, block.size() - offset)), stream_writer);
+        }
+
+        Stream payload_writer(payload);
+        for (size_t i = 0; i + 1 < streams.size(); ++i) {
+            payload_writer.WriteNumber(streams[i].size(), 32);
+        }
+        size_t table_start_bits = payload_writer.BitsWritten();
+        WriteTableHeader(tree.GetHaffmanCodes(), payload_writer);
+        block_stats.table_bits = payload_writer.BitsWritten() - table_start_bits;
+        payload_writer.AlignToByte();
+        for (const std::vector<char> &stream : streams) {
+            payload_writer.WriteBytes(stream.data(), stream.size());
+        }
+    } else if (block_type == BLOCK_HAFFMAN) {
+        Stream payload_writer(payload);
+        WriteTableHeader(tree.GetHaffmanCodes(), payload_writer);
+        block_stats.table_bits = payload_writer.BitsWritten();
+        encode_symbols(block, payload_writer);
     }
-    writer.Write(kanonic_codes[FILENAME_END]);
+    std::span<const char> payload_data = block_type == BLOCK_STORED ? block : std::span<const char>(payload);
+
+    writer.WriteNumber(block_type, 8);
+    writer.WriteNumber(block.size(), 32);
+    writer.WriteNumber(payload_data.size(), 32);
+    writer.WriteBytes(payload_data.data(), payload_data.size());
+    block_stats.times.encode += stopwatch.Lap();
+    if (stats) {
+        *stats += block_stats;
+    }
+}
 
-    while (!reader.Eof()) {
-        unsigned char current_char = reader.ReadChar();
-        auto code_iter = kanonic_codes.find(current_char);
-        if (code_iter == kanonic_codes.end()) {
-            throw std::runtime_error(std::string("Kanonic code for symbol") +
-                                     reinterpret_cast<const char *>(current_char) + std::string("not found!"));
+size_t compressor::EncodeAdaptive(Stream &reader, Stream &writer, Crc32c &checksum) {
+    AdaptiveHaffman model;
+    size_t original_size = 0;
+    ForEachChunk(reader, [&model, &writer, &original_size, &checksum](std::span<const char> chunk) {
+        checksum.Update(chunk);
+        for (char c : chunk) {
+            model.Encode(static_cast<unsigned char>(c), writer);
         }
-        writer.Write(code_iter->second);
+        original_size += chunk.size();
+    });
+    model.Encode(AdaptiveHaffman::END_SYMBOL, writer);
+    writer.AlignToByte();
+    return original_size;
+}
+
+CompressStats compressor::CompressMembers(const std::vector<std::string_view> &filenames,
+                                          const std::vector<std::string_view> &skipped_paths, Stream &writer,
+                                          ArchiveIndex &index, const CompressOptions &options,
+                                          size_t format_version) {
+    if (options.block_size == 0 || options.block_size > MAX_BLOCK_SIZE) {
+        throw std::runtime_error("Block size must be between 1 and " + std::to_string(MAX_BLOCK_SIZE) + " bytes!");
+    }
+    if (options.solid_size > MAX_BLOCK_SIZE) {
+        throw std::runtime_error("Solid group size must not exceed " + std::to_string(MAX_BLOCK_SIZE) + " bytes!");
     }
+    bool has_checksums = format_version >= CHECKSUM_FORMAT_VERSION;
+    bool has_record_checksums = format_version >= RECORD_CHECKSUM_FORMAT_VERSION;
+    Stopwatch wall;
+    CompressStats stats;
+    MemberStats member_stats;
+
+    std::unique_ptr<ThreadPool> pool;
+    size_t max_in_flight = 0;
+    if (options.threads != 1) {
+        pool = std::make_unique<ThreadPool>(options.threads);
+        max_in_flight = 2 * pool->Size();
+    }
+    std::deque<std::future<EncodedBlock>> in_flight;
+    auto flush_in_flight = [&](size_t max_size) {
+        while (in_flight.size() > max_size) {
+            EncodedBlock encoded = in_flight.front().get();
+            in_flight.pop_front();
+            Stopwatch stopwatch;
+            writer.WriteBytes(encoded.data.data(), encoded.data.size());
+            encoded.stats.times.write += stopwatch.Lap();
+            member_stats += encoded.stats;
+        }
+    };
+    auto encode_block = [&](std::vector<char> block_storage, std::span<const char> block) {
+        if (pool) {
+            in_flight.push_back(pool->Submit([block_storage = std::move(block_storage), block, &options] {
+                EncodedBlock encoded;
+                encoded.data = EncodeBlock(block, options, &encoded.stats);
+                return encoded;
+            }));
+            flush_in_flight(max_in_flight);
+        } else {
+            std::vector<char> encoded = EncodeBlock(block, options, &member_stats);
+            Stopwatch stopwatch;
+            writer.WriteBytes(encoded.data(), encoded.size());
+            member_stats.times.write += stopwatch.Lap();
+        }
+    };
+
+    std::vector<MemberInfo> solid_members;
+    std::vector<char> solid_data;
+    MemberStats solid_stats;
+    auto flush_solid_group = [&] {
+        if (solid_members.empty()) {
+            return;
+        }
+        size_t offset = writer.BitsWritten() / 8;
+        member_stats = std::move(solid_stats);
+        member_stats.name = "solid group of " + std::to_string(solid_members.size()) + " files";
+        writer.WriteNumber(SOLID_TAG, 8);
+        writer.WriteNumber(solid_members.size(), 32);
+        for (const MemberInfo &member : solid_members) {
+            writer.WriteNumber(member.name.size(), 16);
+            writer.WriteBytes(member.name.data(), member.name.size());
+            writer.WriteNumber(member.original_size, 32);
+        }
+        for (size_t position = 0; position < solid_data.size(); position += options.block_size) {
+            encode_block({}, std::span<const char>(solid_data).subspan(
+                                 position, std::min(options.block_size, solid_data.size() - position)));
+        }
+        flush_in_flight(0);
+        writer.WriteNumber(BLOCK_END, 8);
+        if (has_checksums) {
+            Crc32c checksum;
+            if (has_record_checksums) {
+                for (const MemberInfo &member : solid_members) {
+                    decompressor::UpdateRecordChecksum(checksum, member.name, member.original_size);
+                }
+            }
+            checksum.Update(solid_data);
+            writer.WriteNumber(checksum.GetValue(), 32);
+        }
+
+        size_t compressed_size = writer.BitsWritten() / 8 - offset;
+        for (MemberInfo &member : solid_members) {
+            member.offset = offset;
+            member.compressed_size = compressed_size;
+            index.AddMember(std::move(member));
+        }
+        member_stats.bits_out = compressed_size * 8;
+        stats.AddMember(std::move(member_stats));
+        solid_members.clear();
+        solid_data.clear();
+        solid_stats = {};
+    };
+
+    // The archive itself is skipped when it is written into one of the archived directories.
+    FileWalker walker(filenames, skipped_paths);
+    while (std::optional<InputFile> file = walker.Next()) {
+        flush_in_flight(0);
+        Stopwatch stopwatch;
+        Stream reader(file->path, 'r');
+        std::string_view filename = file->name;
+        double open_seconds = stopwatch.Lap();
+        if (filename.size() > MAX_FILENAME_SIZE) {
+            throw std::runtime_error("File name " + std::string(filename) + " is too long!");
+        }
+        if (!options.adaptive && reader.IsSeekable() && reader.Size() < options.solid_size) {
+            size_t file_size = reader.Size();
+            if (solid_data.size() + file_size > options.solid_size) {
+                flush_solid_group();
+            }
+            stopwatch.Lap();
+            size_t solid_offset = solid_data.size();
+            solid_data.resize(solid_offset + file_size);
+            solid_data.resize(solid_offset + reader.ReadBytes(solid_data.data() + solid_offset, file_size));
+            solid_members.push_back({.name = std::string(filename), .original_size = solid_data.size() - solid_offset});
+            solid_stats.times.read += open_seconds + stopwatch.Lap();
+            continue;
+        }
+        flush_solid_group();
+        member_stats = {.name = std::string(filename)};
+        member_stats.times.read += open_seconds;
 
-    if (is_last_file) {
-        auto code_iter = kanonic_codes.find(ARCHIVE_END);
-        if (code_iter == kanonic_codes.end()) {
-            throw std::runtime_error("Kanonic code for symbol ARCHIVE_END not found");
+        MemberInfo member{.name = std::string(filename), .offset = writer.BitsWritten() / 8};
+        writer.WriteNumber(MEMBER_TAG, 8);
+        writer.WriteNumber(filename.size(), 16);
+        writer.WriteBytes(filename.data(), filename.size());
+
+        Crc32c checksum;
+        if (has_record_checksums) {
+            decompressor::UpdateRecordChecksum(checksum, filename);
+        }
+        if (options.adaptive) {
+            writer.WriteNumber(BLOCK_ADAPTIVE, 8);
+            stopwatch.Lap();
+            member.original_size = EncodeAdaptive(reader, writer, checksum);
+            member_stats.bytes_in = member.original_size;
+            member_stats.times.encode += stopwatch.Lap();
+        }
+        std::optional<std::span<const char>> contiguous_data = reader.GetContiguousData();
+        while (!options.adaptive) {
+            stopwatch.Lap();
+            std::vector<char> block_storage;
+            std::span<const char> block;
+            if (contiguous_data.has_value()) {
+                block = contiguous_data->subspan(member.original_size,
+                                                 std::min(options.block_size,
+                                                          contiguous_data->size() - member.original_size));
+            } else {
+                block_storage.resize(options.block_size);
+                block_storage.resize(reader.ReadBytes(block_storage.data(), block_storage.size()));
+                block = block_storage;
+            }
+            checksum.Update(block);
+            member_stats.times.read += stopwatch.Lap();
+            if (block.empty()) {
+                break;
+            }
+            member.original_size += block.size();
+            encode_block(std::move(block_storage), block);
         }
-        writer.Write(code_iter->second);
-    } else {
-        auto code_iter = kanonic_codes.find(ONE_MORE_FILE);
-        if (code_iter == kanonic_codes.end()) {
-            throw std::runtime_error("Kanonic code for symbol ONE_MORE_FILE not found");
+
+        flush_in_flight(0);
+        writer.WriteNumber(BLOCK_END, 8);
+        if (has_checksums) {
+            writer.WriteNumber(checksum.GetValue(), 32);
         }
-        writer.Write(code_iter->second);
+        member.compressed_size = writer.BitsWritten() / 8 - member.offset;
+        member_stats.bits_out = member.compressed_size * 8;
+        index.AddMember(std::move(member));
+        stats.AddMember(std::move(member_stats));
     }
+    flush_solid_group();
+    writer.WriteNumber(ARCHIVE_END_TAG, 8);
+    index.Write(writer);
+    stats.SetWallSeconds(wall.Lap());
+    return stats;
 }
 
-void compressor::Compress(const std::vector<std::string_view> &filenames, std::string_view archive_name) {
+CompressStats compressor::CompressBlocks(const std::vector<std::string_view> &filenames, std::string_view archive_name,
+                                         const CompressOptions &options) {
     Stream writer(archive_name, 'w');
+    writer.WriteNumber(0, 16);
+    writer.WriteNumber(FORMAT_MAGIC, 16);
+    writer.WriteNumber(BLOCK_FORMAT_VERSION, 8);
+    writer.WriteNumber(options.block_size, 32);
+    ArchiveIndex index;
+    std::vector<std::string_view> skipped_paths;
+    if (archive_name != Stream::STANDARD_STREAM_NAME) {
+        skipped_paths.push_back(archive_name);
+    }
+    return CompressMembers(filenames, skipped_paths, writer, index, options, BLOCK_FORMAT_VERSION);
+}
 
-    for (size_t i = 0; i < filenames.size(); ++i) {
-        bool is_last_file = (i + 1) == filenames.size();
-        CompressFile(filenames[i], is_last_file, writer);
+CompressStats compressor::Append(const std::vector<std::string_view> &filenames, std::string_view archive_name,
+                                 const CompressOptions &options) {
+    if (archive_name == Stream::STANDARD_STREAM_NAME) {
+        throw std::runtime_error("Files can't be appended to an archive on standard output!");
+    }
+    CompressOptions append_options = options;
+    if (!std::filesystem::exists(archive_name)) {
+        if (append_options.block_size == 0) {
+            append_options.block_size = DEFAULT_BLOCK_SIZE;
+        }
+        return CompressBlocks(filenames, archive_name, append_options);
     }
-}
\ No newline at end of file
+
+    auto wrong_format_error =
+        std::runtime_error("File " + std::string(archive_name) + " has wrong decompressed file format!");
+    decompressor::BlockArchiveHeader header;
+    ArchiveIndex index;
+    size_t members_end = 0;
+    {
+        Stream reader(archive_name, 'r', true);
+        if (!decompressor::IsBlockArchive(reader)) {
+            throw std::runtime_error("Files can't be appended to " + std::string(archive_name) +
+                                     ", which is not a block archive (create it with -a or -b)!");
+        }
+        header = decompressor::ReadBlockArchiveHeader(reader, wrong_format_error);
+        members_end = reader.Tell();
+        std::optional<ArchiveIndex> archive_index = ArchiveIndex::Read(reader);
+        if (!archive_index.has_value()) {
+            throw wrong_format_error;
+        }
+        index = std::move(archive_index.value());
+        for (const MemberInfo &member : index.GetMembers()) {
+            members_end = std::max(members_end, member.offset + member.compressed_size);
+        }
+        reader.Seek(members_end);
+        if (reader.ReadUInt(8) != ARCHIVE_END_TAG) {
+            throw wrong_format_error;
+        }
+    }
+
+    // The new members are encoded into a temporary file at the offsets they will have in the archive; the
+    // prefix is left as a hole, so it costs no copying. The archive is changed only once every input has been
+    // encoded, and a failing input leaves it as it was.
+    TemporaryFile temporary_file(std::string(archive_name) + ".append");
+    const std::string &temporary_name = temporary_file.GetPath();
+    append_options.block_size = header.block_size;
+    CompressStats stats;
+    {
+        std::filesystem::resize_file(temporary_name, members_end);
+        Stream writer(temporary_name, 'a');
+        stats = CompressMembers(filenames, {archive_name, temporary_name}, writer, index, append_options,
+                                header.version);
+    }
+
+    // Only the end tag and the index follow the members. The new tail overwrites them in place and the archive
+    // is cut to its new length only after the copy has succeeded; if the copy fails, the old tail is put back.
+    size_t archive_size = std::filesystem::file_size(archive_name);
+    size_t tail_size = std::filesystem::file_size(temporary_name) - members_end;
+    std::vector<char> old_tail(archive_size - members_end);
+    {
+        Stream reader(archive_name, 'r');
+        reader.Seek(members_end);
+        reader.ReadBytes(old_tail.data(), old_tail.size());
+    }
+    auto write_tail = [&archive_name, members_end](auto &&copy) {
+        std::ofstream archive(std::string(archive_name), std::ios::in | std::ios::out | std::ios::binary);
+        archive.seekp(members_end);
+        copy(archive);
+        archive.flush();
+        if (!archive) {
+            throw std::runtime_error("Can't write to file " + std::string(archive_name));
+        }
+    };
+    try {
+        write_tail([&temporary_name, members_end](std::ofstream &archive) {
+            Stream reader(temporary_name, 'r');
+            reader.Seek(members_end);
+            std::vector<char> chunk(READ_CHUNK_SIZE);
+            while (size_t chunk_size = reader.ReadBytes(chunk.data(), chunk.size())) {
+                archive.write(chunk.data(), chunk_size);
+            }
+        });
+        std::filesystem::resize_file(archive_name, members_end + tail_size);
+    } catch (...) {
+        try {
+            write_tail([&old_tail](std::ofstream &archive) { archive.write(old_tail.data(), old_tail.size()); });
+            std::filesystem::resize_file(archive_name, archive_size);
+        } catch (...) {
+        }
+        throw;
+    }
+    return stats;
+}
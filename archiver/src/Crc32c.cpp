@@ -0,0 +1,90 @@
+#include "Crc32c.h"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_HAS_SSE42
+#endif
+
+namespace {
+
+const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+using Crc32cTables = std::array<std::array<uint32_t, 256>, 8>;
+
+constexpr Crc32cTables MakeTables() {
+    Crc32cTables tables{};
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+        uint32_t crc = byte;
+        for (size_t bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLYNOMIAL : 0);
+        }
+        tables[0][byte] = crc;
+    }
+    for (size_t table = 1; table < tables.size(); ++table) {
+        for (size_t byte = 0; byte < 256; ++byte) {
+            uint32_t previous = tables[table - 1][byte];
+            tables[table][byte] = (previous >> 8) ^ tables[0][previous & 0xFF];
+        }
+    }
+    return tables;
+}
+
+constexpr Crc32cTables CRC32C_TABLES = MakeTables();
+
+uint32_t UpdateTables(uint32_t crc, const unsigned char *data, size_t size) {
+    const Crc32cTables &tables = CRC32C_TABLES;
+    for (; size >= 8; data += 8, size -= 8) {
+        uint32_t low = crc ^ (data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24));
+        crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^ tables[5][(low >> 16) & 0xFF] ^
+              tables[4][low >> 24] ^ tables[3][data[4]] ^ tables[2][data[5]] ^ tables[1][data[6]] ^
+              tables[0][data[7]];
+    }
+    for (; size > 0; ++data, --size) {
+        crc = (crc >> 8) ^ tables[0][(crc ^ *data) & 0xFF];
+    }
+    return crc;
+}
+
+#ifdef CRC32C_HAS_SSE42
+__attribute__((target("sse4.2"))) uint32_t UpdateHardware(uint32_t crc, const unsigned char *data, size_t size) {
+    uint64_t crc64 = crc;
+    for (; size >= 8; data += 8, size -= 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for (; size > 0; ++data, --size) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+}
+#endif
+
+}  // namespace
+
+bool Crc32c::HasHardwareSupport() {
+#ifdef CRC32C_HAS_SSE42
+    static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+    return has_sse42;
+#else
+    return false;
+#endif
+}
+
+void Crc32c::Update(std::span<const char> data) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data.data());
+#ifdef CRC32C_HAS_SSE42
+    if (HasHardwareSupport()) {
+        state_ = UpdateHardware(state_, bytes, data.size());
+        return;
+    }
+#endif
+    state_ = UpdateTables(state_, bytes, data.size());
+}
+
+uint32_t Crc32c::GetValue() const {
+    return ~state_;
+}
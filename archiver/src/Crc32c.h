@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+// CRC-32C (Castagnoli) of a byte sequence, updated chunk by chunk. Uses the SSE4.2 crc32 instruction
+// when the CPU has it and a slicing-by-8 table otherwise; both give the same values.
+class Crc32c {
+private:
+    uint32_t state_ = 0xFFFFFFFF;
+
+public:
+    static bool HasHardwareSupport();
+
+    void Update(std::span<const char> data);
+
+    uint32_t GetValue() const;
+};
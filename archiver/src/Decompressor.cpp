@@ -1,138 +1,630 @@
 #include "Archiver.h"
+#include <algorithm>
+#include <climits>
+#include <iterator>
+
+namespace {
+
+// Collects symbols decoded one by one into chunks of READ_CHUNK_SIZE bytes for a sink.
+class ChunkBuffer {
+private:
+    const decompressor::MemberSink *sink_;
+    std::vector<char> chunk_;
+
+public:
+    explicit ChunkBuffer(const decompressor::MemberSink *sink) : sink_(sink) {
+    }
+
+    void Push(char c) {
+        if (!sink_) {
+            return;
+        }
+        chunk_.push_back(c);
+        if (chunk_.size() == READ_CHUNK_SIZE) {
+            Flush();
+        }
+    }
+
+    void Flush() {
+        if (sink_ && !chunk_.empty()) {
+            (*sink_)(chunk_);
+            chunk_.clear();
+        }
+    }
+};
+
+}  // namespace
 
 size_t decompressor::ToNum(const std::vector<bool> &bin, bool is_little) {
     size_t res = 0;
     for (size_t i = 0; i < bin.size(); ++i) {
         bool bit = is_little ? bin[i] : bin[bin.size() - 1 - i];
         if (bit) {
-            res += (1 << i);
+            res += (size_t{1} << i);
         }
     }
     return res;
 }
 
-void decompressor::Decompress(std::string_view archive_name) {
-    Stream reader(archive_name, 'r', true);
+std::vector<std::pair<size_t, size_t>> decompressor::ReadTableHeader(Stream &reader,
+                                                                     const std::runtime_error &wrong_format_error) {
+    std::vector<std::pair<size_t, size_t>> symbols;
+    ReadTableHeader(reader, symbols, wrong_format_error);
+    return symbols;
+}
 
-    auto wrong_format_error =
-        std::runtime_error("File " + std::string(archive_name) + " has wrong decompressed file format!");
-    bool archive_eof = false;
-    std::vector<bool> temp_buffer;
+void decompressor::ReadTableHeader(Stream &reader, std::vector<std::pair<size_t, size_t>> &symbols,
+                                   const std::runtime_error &wrong_format_error) {
+    if (reader.Eof()) {
+        throw wrong_format_error;
+    }
+    size_t symbols_count = reader.ReadUInt(BYTE_SIZE);
 
-    while (!archive_eof) {
-        temp_buffer = std::vector<bool>(BYTE_SIZE, false);
+    symbols.clear();
+    symbols.reserve(symbols_count);
+    for (size_t i = 0; i < symbols_count; ++i) {
+        if (reader.Eof()) {
+            throw wrong_format_error;
+        }
+        symbols.push_back({reader.ReadUInt(BYTE_SIZE), 0});
+    }
 
+    size_t current_symbol = 0;
+    for (size_t current_size = 1; current_symbol < symbols_count; ++current_size) {
         if (reader.Eof()) {
             throw wrong_format_error;
         }
-        reader.ReadBits(BYTE_SIZE, temp_buffer);
-        size_t symbols_count = ToNum(temp_buffer);
+        size_t current_size_count = reader.ReadUInt(BYTE_SIZE);
+        for (size_t j = 0; j < current_size_count; ++j) {
+            if (current_symbol >= symbols.size()) {
+                throw wrong_format_error;
+            }
+            symbols[current_symbol].second = current_size;
+            ++current_symbol;
+        }
+    }
+}
+
+std::vector<char> decompressor::DecodeBlock(size_t block_type, std::span<const char> payload, size_t block_size,
+                                            const std::runtime_error &wrong_format_error) {
+    std::vector<char> block(block_size);
+    DecodeBlock(block_type, payload, block, wrong_format_error);
+    return block;
+}
+
+void decompressor::DecodeBlock(size_t block_type, std::span<const char> payload, std::span<char> block,
+                               const std::runtime_error &wrong_format_error) {
+    BlockDecodeBuffers buffers;
+    DecodeBlock(block_type, payload, block, buffers, wrong_format_error);
+}
+
+void decompressor::DecodeBlock(size_t block_type, std::span<const char> payload, std::span<char> block,
+                               BlockDecodeBuffers &buffers, const std::runtime_error &wrong_format_error) {
+    size_t block_size = block.size();
+    if (block_type == BLOCK_STORED) {
+        if (payload.size() != block_size) {
+            throw wrong_format_error;
+        }
+        std::copy(payload.begin(), payload.end(), block.begin());
+        return;
+    }
+
+    Stream reader(std::as_bytes(payload));
+    HaffmanDecoder &decoder = buffers.decoder;
+    if (block_type != BLOCK_HAFFMAN_INTERLEAVED) {
+        ReadTableHeader(reader, buffers.symbols, wrong_format_error);
+        decoder.Restore(buffers.symbols);
+        if (!decoder.DecodeBytes(payload, reader.BitsRead(), block)) {
+            throw wrong_format_error;
+        }
+        return;
+    }
+
+    std::array<size_t, INTERLEAVED_STREAMS_COUNT> stream_sizes;
+    for (size_t i = 0; i + 1 < stream_sizes.size(); ++i) {
+        stream_sizes[i] = reader.ReadUInt(32);
+    }
+    ReadTableHeader(reader, buffers.symbols, wrong_format_error);
+    decoder.Restore(buffers.symbols);
+    reader.AlignToByte();
+
+    size_t stream_offset = reader.Tell();
+    size_t segment_size = (block_size + INTERLEAVED_STREAMS_COUNT - 1) / INTERLEAVED_STREAMS_COUNT;
+    std::array<std::span<const char>, INTERLEAVED_STREAMS_COUNT> streams;
+    std::array<std::span<char>, INTERLEAVED_STREAMS_COUNT> segments;
+    for (size_t i = 0; i < INTERLEAVED_STREAMS_COUNT; ++i) {
+        if (stream_offset > payload.size()) {
+            throw wrong_format_error;
+        }
+        if (i + 1 == INTERLEAVED_STREAMS_COUNT) {
+            stream_sizes[i] = payload.size() - stream_offset;
+        }
+        if (stream_sizes[i] > payload.size() - stream_offset) {
+            throw wrong_format_error;
+        }
+        streams[i] = payload.subspan(stream_offset, stream_sizes[i]);
+        stream_offset += stream_sizes[i];
 
-        std::vector<std::pair<size_t, size_t>> symbols;
-        for (size_t i = 0; i < symbols_count; ++i) {
-            if (reader.Eof()) {
+        size_t segment_begin = std::min(i * segment_size, block_size);
+        segments[i] = block.subspan(segment_begin, std::min(segment_size, block_size - segment_begin));
+    }
+    if (!decoder.DecodeInterleaved(streams, segments)) {
+        throw wrong_format_error;
+    }
+}
+
+size_t decompressor::DecodeAdaptive(Stream &reader, const MemberSink *sink,
+                                    const std::runtime_error &wrong_format_error) {
+    AdaptiveHaffman model;
+    size_t original_size = 0;
+    ChunkBuffer chunk(sink);
+    while (true) {
+        std::optional<size_t> symbol = model.Decode(reader);
+        if (!symbol.has_value()) {
+            throw wrong_format_error;
+        }
+        if (symbol.value() == AdaptiveHaffman::END_SYMBOL) {
+            break;
+        }
+        chunk.Push(static_cast<char>(symbol.value()));
+        ++original_size;
+    }
+    chunk.Flush();
+    reader.AlignToByte();
+    return original_size;
+}
+
+decompressor::BlockArchiveHeader decompressor::ReadBlockArchiveHeader(Stream &reader,
+                                                                     const std::runtime_error &wrong_format_error) {
+    if (reader.ReadUInt(16) != 0 || reader.ReadUInt(16) != FORMAT_MAGIC) {
+        throw wrong_format_error;
+    }
+    size_t version = reader.ReadUInt(8);
+    if (version < MIN_BLOCK_FORMAT_VERSION || version > BLOCK_FORMAT_VERSION) {
+        throw wrong_format_error;
+    }
+    BlockArchiveHeader header{.version = version,
+                              .block_size = reader.ReadUInt(32),
+                              .has_checksums = version >= CHECKSUM_FORMAT_VERSION,
+                              .has_record_checksums = version >= RECORD_CHECKSUM_FORMAT_VERSION};
+    if (header.block_size == 0 || header.block_size > MAX_BLOCK_SIZE) {
+        throw wrong_format_error;
+    }
+    return header;
+}
+
+std::string decompressor::ReadMemberName(Stream &reader, const std::runtime_error &wrong_format_error) {
+    std::string filename(reader.ReadUInt(16), '\0');
+    if (reader.ReadBytes(filename.data(), filename.size()) != filename.size()) {
+        throw wrong_format_error;
+    }
+    return filename;
+}
+
+void decompressor::CheckBlockSizes(size_t block_type, size_t original_size, size_t payload_size, size_t block_size,
+                                   const std::runtime_error &wrong_format_error) {
+    if (original_size == 0 || original_size > block_size) {
+        throw wrong_format_error;
+    }
+    if (block_type == BLOCK_STORED) {
+        if (payload_size != original_size) {
+            throw wrong_format_error;
+        }
+    } else if (original_size > CHAR_BIT * payload_size || payload_size > original_size + MAX_TABLE_HEADER_SIZE) {
+        throw wrong_format_error;
+    }
+}
+
+void decompressor::UpdateRecordChecksum(Crc32c &checksum, std::string_view name) {
+    std::array<char, 2> name_size = {static_cast<char>(name.size() >> 8), static_cast<char>(name.size())};
+    checksum.Update(name_size);
+    checksum.Update(name);
+}
+
+void decompressor::UpdateRecordChecksum(Crc32c &checksum, std::string_view name, size_t original_size) {
+    UpdateRecordChecksum(checksum, name);
+    std::array<char, 4> size = {static_cast<char>(original_size >> 24), static_cast<char>(original_size >> 16),
+                                static_cast<char>(original_size >> 8), static_cast<char>(original_size)};
+    checksum.Update(size);
+}
+
+void decompressor::VerifyChecksum(Stream &reader, const Crc32c &checksum, std::string_view member_name,
+                                  const std::runtime_error &wrong_format_error) {
+    if (reader.Eof()) {
+        throw wrong_format_error;
+    }
+    if (reader.ReadUInt(32) != checksum.GetValue()) {
+        throw std::runtime_error("Checksum mismatch in " + std::string(member_name) + ", the archive is corrupted!");
+    }
+}
+
+size_t decompressor::DecompressMemberBlocks(Stream &reader, const MemberSink *sink, const BlockArchiveHeader &header,
+                                            const Crc32c &record_checksum, ThreadPool *pool,
+                                            std::string_view member_name,
+                                            const std::runtime_error &wrong_format_error) {
+    // The checksum is updated in output order on this thread, so parallel decoding does not change it.
+    Crc32c checksum = record_checksum;
+    MemberSink emit;
+    if (sink) {
+        emit = [sink, &checksum, &header](std::span<const char> data) {
+            if (header.has_checksums) {
+                checksum.Update(data);
+            }
+            (*sink)(data);
+        };
+    }
+    size_t max_in_flight = pool ? 2 * pool->Size() : 0;
+    std::deque<std::future<std::vector<char>>> in_flight;
+    auto flush_in_flight = [&in_flight, &emit](size_t max_size) {
+        while (in_flight.size() > max_size) {
+            std::vector<char> block = in_flight.front().get();
+            in_flight.pop_front();
+            emit(block);
+        }
+    };
+
+    std::optional<std::span<const char>> contiguous_data = reader.GetContiguousData();
+    size_t member_size = 0;
+    while (true) {
+        if (reader.Eof()) {
+            throw wrong_format_error;
+        }
+        size_t block_type = reader.ReadUInt(8);
+        if (block_type == BLOCK_END) {
+            break;
+        }
+        if (block_type == BLOCK_ADAPTIVE) {
+            if (sink) {
+                flush_in_flight(0);
+            }
+            member_size += DecodeAdaptive(reader, sink ? &emit : nullptr, wrong_format_error);
+            continue;
+        }
+        if (block_type != BLOCK_HAFFMAN && block_type != BLOCK_HAFFMAN_INTERLEAVED && block_type != BLOCK_STORED) {
+            throw wrong_format_error;
+        }
+        size_t original_size = reader.ReadUInt(32);
+        size_t payload_size = reader.ReadUInt(32);
+        CheckBlockSizes(block_type, original_size, payload_size, header.block_size, wrong_format_error);
+        member_size += original_size;
+        if (!sink) {
+            reader.Skip(payload_size);
+            continue;
+        }
+        std::vector<char> payload_storage;
+        std::span<const char> payload;
+        if (contiguous_data.has_value()) {
+            if (reader.Tell() + payload_size > contiguous_data->size()) {
+                throw wrong_format_error;
+            }
+            payload = contiguous_data->subspan(reader.Tell(), payload_size);
+            reader.Seek(reader.Tell() + payload_size);
+        } else {
+            payload_storage.resize(payload_size);
+            if (reader.ReadBytes(payload_storage.data(), payload_storage.size()) != payload_storage.size()) {
                 throw wrong_format_error;
             }
-            reader.ReadBits(BYTE_SIZE, temp_buffer);
-            symbols.push_back({ToNum(temp_buffer), 0});
+            payload = payload_storage;
         }
+        if (block_type == BLOCK_STORED && in_flight.empty()) {
+            if (payload.size() != original_size) {
+                throw wrong_format_error;
+            }
+            emit(payload);
+        } else if (pool) {
+            in_flight.push_back(
+                pool->Submit([payload_storage = std::move(payload_storage), block_type, payload, original_size,
+                              wrong_format_error] {
+                    return DecodeBlock(block_type, payload, original_size, wrong_format_error);
+                }));
+            flush_in_flight(max_in_flight);
+        } else {
+            emit(DecodeBlock(block_type, payload, original_size, wrong_format_error));
+        }
+    }
+    flush_in_flight(0);
+    if (header.has_checksums && sink) {
+        VerifyChecksum(reader, checksum, member_name, wrong_format_error);
+    } else if (header.has_checksums) {
+        reader.Skip(4);
+    }
+    return member_size;
+}
+
+std::vector<MemberInfo> decompressor::DecompressSolidGroup(Stream &reader, size_t offset,
+                                                           const BlockArchiveHeader &header, ThreadPool *pool,
+                                                           const DecompressOptions &options, bool list_only,
+                                                           const std::runtime_error &wrong_format_error) {
+    size_t members_count = reader.ReadUInt(32);
+    std::vector<MemberInfo> members;
+    size_t group_size = 0;
+    bool has_selected = false;
+    Crc32c record_checksum;
+    for (size_t i = 0; i < members_count; ++i) {
+        if (reader.Eof()) {
+            throw wrong_format_error;
+        }
+        MemberInfo member{.name = ReadMemberName(reader, wrong_format_error), .offset = offset};
+        member.original_size = reader.ReadUInt(32);
+        if (header.has_record_checksums) {
+            UpdateRecordChecksum(record_checksum, member.name, member.original_size);
+        }
+        group_size += member.original_size;
+        has_selected = has_selected || (!list_only && IsSelected(member.name, options));
+        members.push_back(std::move(member));
+    }
 
-        size_t current_symbol = 0;
-        for (size_t current_size = 1; current_symbol < symbols_count; ++current_size) {
-            if (reader.Eof()) {
+    // Decoded data of the group is split between its members on the fly, so the group is never buffered.
+    size_t position = 0;
+    size_t member_end = 0;
+    size_t next_member = 0;
+    MemberSink member_sink;
+    auto open_next_members = [&] {
+        while (position == member_end && next_member < members.size()) {
+            const MemberInfo &member = members[next_member++];
+            member_sink = {};
+            if (IsSelected(member.name, options)) {
+                member_sink = OpenMember(member.name, options);
+            }
+            member_end += member.original_size;
+        }
+    };
+    MemberSink sink = [&](std::span<const char> data) {
+        while (!data.empty()) {
+            open_next_members();
+            if (position == member_end) {
                 throw wrong_format_error;
             }
-            reader.ReadBits(BYTE_SIZE, temp_buffer);
-            size_t current_size_count = ToNum(temp_buffer);
-            for (size_t j = 0; j < current_size_count; ++j) {
-                if (current_symbol >= symbols.size()) {
-                    throw wrong_format_error;
-                }
-                symbols[current_symbol].second = current_size;
-                ++current_symbol;
+            size_t size = std::min(data.size(), member_end - position);
+            if (member_sink) {
+                member_sink(data.first(size));
             }
+            position += size;
+            data = data.subspan(size);
+        }
+    };
+    std::string group_name = "solid group at offset " + std::to_string(offset);
+    if (DecompressMemberBlocks(reader, has_selected ? &sink : nullptr, header, record_checksum, pool, group_name,
+                               wrong_format_error) != group_size) {
+        throw wrong_format_error;
+    }
+    if (has_selected) {
+        open_next_members();
+        member_sink = {};
+    }
+
+    size_t compressed_size = reader.Tell() - offset;
+    for (MemberInfo &member : members) {
+        member.compressed_size = compressed_size;
+    }
+    return members;
+}
+
+void decompressor::PrepareMemberPath(const std::string &name) {
+    std::filesystem::path path(name);
+    bool is_safe = !name.empty() && path.is_relative();
+    for (const std::filesystem::path &part : path) {
+        is_safe = is_safe && part != "..";
+    }
+    if (!is_safe) {
+        throw std::runtime_error("File name " + name + " points outside of the current directory!");
+    }
+    if (path.has_parent_path()) {
+        std::filesystem::create_directories(path.parent_path());
+    }
+}
+
+decompressor::MemberSink decompressor::OpenMember(const std::string &name, const DecompressOptions &options) {
+    if (options.output) {
+        return options.output(name);
+    }
+    PrepareMemberPath(name);
+    auto writer = std::make_shared<Stream>(name, 'w');
+    return [writer](std::span<const char> data) { writer->WriteBytes(data.data(), data.size()); };
+}
+
+bool decompressor::IsSelected(std::string_view filename, const DecompressOptions &options) {
+    return options.members.empty() ||
+           std::find(options.members.begin(), options.members.end(), filename) != options.members.end();
+}
+
+std::vector<MemberInfo> decompressor::DecompressBlocks(Stream &reader, std::string_view archive_name,
+                                                       const DecompressOptions &options, bool list_only) {
+    auto wrong_format_error =
+        std::runtime_error("File " + std::string(archive_name) + " has wrong decompressed file format!");
+    BlockArchiveHeader header = ReadBlockArchiveHeader(reader, wrong_format_error);
+
+    std::unique_ptr<ThreadPool> pool;
+    if (options.threads != 1 && !list_only) {
+        pool = std::make_unique<ThreadPool>(options.threads);
+    }
+
+    std::vector<MemberInfo> members;
+    while (true) {
+        if (reader.Eof()) {
+            throw wrong_format_error;
+        }
+        size_t offset = reader.Tell();
+        size_t tag = reader.ReadUInt(8);
+        if (tag == ARCHIVE_END_TAG) {
+            break;
+        }
+        if (tag == SOLID_TAG) {
+            std::vector<MemberInfo> group =
+                DecompressSolidGroup(reader, offset, header, pool.get(), options, list_only, wrong_format_error);
+            std::move(group.begin(), group.end(), std::back_inserter(members));
+            continue;
+        }
+        if (tag != MEMBER_TAG) {
+            throw wrong_format_error;
         }
+        MemberInfo member{.name = ReadMemberName(reader, wrong_format_error), .offset = offset};
 
-        std::shared_ptr<HaffmanTree::TrieNode> trie_root = HaffmanTree::RestoreKanonicCodes(symbols);
-        std::shared_ptr<HaffmanTree::TrieNode> current_node = trie_root;
+        Crc32c record_checksum;
+        if (header.has_record_checksums) {
+            UpdateRecordChecksum(record_checksum, member.name);
+        }
+
+        MemberSink sink;
+        if (!list_only && IsSelected(member.name, options)) {
+            sink = OpenMember(member.name, options);
+        }
+        member.original_size = DecompressMemberBlocks(reader, sink ? &sink : nullptr, header, record_checksum,
+                                                      pool.get(), member.name, wrong_format_error);
+        member.compressed_size = reader.Tell() - offset;
+        members.push_back(std::move(member));
+    }
+    return members;
+}
 
-        std::string filename;
-        temp_buffer = {false};
+std::vector<MemberInfo> decompressor::DecompressLegacy(Stream &reader, std::string_view archive_name,
+                                                       const DecompressOptions &options, bool list_only) {
+    auto wrong_format_error =
+        std::runtime_error("File " + std::string(archive_name) + " has wrong decompressed file format!");
+    bool archive_eof = false;
+
+    std::vector<MemberInfo> members;
+    while (!archive_eof) {
+        size_t start_bits = reader.BitsRead();
+        HaffmanDecoder decoder = HaffmanTree::RestoreKanonicCodes(ReadTableHeader(reader, wrong_format_error));
+
+        MemberInfo member;
         while (true) {
-            while (!current_node->code.has_value()) {
-                if (reader.Eof()) {
-                    throw wrong_format_error;
-                }
-                reader.ReadBits(1, temp_buffer);
-                if (!temp_buffer[0]) {
-                    if (!current_node->left) {
-                        throw wrong_format_error;
-                    }
-                    current_node = current_node->left;
-                } else {
-                    if (!current_node->right) {
-                        throw wrong_format_error;
-                    }
-                    current_node = current_node->right;
-                }
+            std::optional<size_t> symbol = decoder.Decode(reader);
+            if (!symbol.has_value()) {
+                throw wrong_format_error;
             }
-            if (current_node->code.value() != FILENAME_END) {
-                filename += static_cast<char>(current_node->code.value());
-                current_node = trie_root;
-            } else {
+            if (symbol.value() == FILENAME_END) {
                 break;
             }
+            member.name += static_cast<char>(symbol.value());
         }
 
-        Stream writer(filename, 'w');
-        current_node = trie_root;
+        MemberSink sink;
+        if (!list_only && IsSelected(member.name, options)) {
+            sink = OpenMember(member.name, options);
+        }
+        ChunkBuffer chunk(sink ? &sink : nullptr);
         while (true) {
-            while (!current_node->code.has_value()) {
-                if (reader.Eof()) {
-                    throw wrong_format_error;
-                }
-                reader.ReadBits(1, temp_buffer);
-                if (!temp_buffer[0]) {
-                    if (!current_node->left) {
-                        throw wrong_format_error;
-                    }
-                    current_node = current_node->left;
-                } else {
-                    if (!current_node->right) {
-                        throw wrong_format_error;
-                    }
-                    current_node = current_node->right;
-                }
+            std::optional<size_t> symbol = decoder.Decode(reader);
+            if (!symbol.has_value()) {
+                throw wrong_format_error;
             }
-            if (current_node->code.value() != ONE_MORE_FILE && current_node->code.value() != ARCHIVE_END) {
-                writer.WriteByte(current_node->code.value());
-                current_node = trie_root;
-            } else {
+            if (symbol.value() == ONE_MORE_FILE || symbol.value() == ARCHIVE_END) {
+                archive_eof = symbol.value() == ARCHIVE_END;
                 break;
             }
+            chunk.Push(static_cast<char>(symbol.value()));
+            ++member.original_size;
         }
+        chunk.Flush();
+        // Members are packed bit by bit, so the byte counts of neighbours overlap by at most one byte.
+        member.compressed_size = (reader.BitsRead() - start_bits + 7) / 8;
+        members.push_back(std::move(member));
+    }
+    return members;
+}
+
+bool decompressor::IsBlockArchive(Stream &reader) {
+    return reader.Peek(16) == 0;
+}
 
-        if (current_node->code.value() == ARCHIVE_END) {
-            archive_eof = true;
+bool decompressor::HasIndex(std::string_view archive_name) {
+    if (archive_name == Stream::STANDARD_STREAM_NAME) {
+        return false;
+    }
+    Stream reader(archive_name, 'r', true);
+    return IsBlockArchive(reader) && reader.IsSeekable() && ArchiveIndex::Read(reader).has_value();
+}
+
+std::vector<MemberInfo> decompressor::DecompressArchive(Stream &reader, std::string_view archive_name,
+                                                        const DecompressOptions &options) {
+    std::vector<MemberInfo> members;
+    if (IsBlockArchive(reader)) {
+        members = DecompressBlocks(reader, archive_name, options, false);
+    } else {
+        members = DecompressLegacy(reader, archive_name, options, false);
+    }
+
+    for (const std::string &name : options.members) {
+        auto is_member = [&name](const MemberInfo &member) { return member.name == name; };
+        if (std::find_if(members.begin(), members.end(), is_member) == members.end()) {
+            throw std::runtime_error("File " + name + " not found in archive " + std::string(archive_name));
         }
-        current_node.reset();
+    }
+    return members;
+}
 
-        std::vector<std::shared_ptr<HaffmanTree::TrieNode>> trie_nodes;
-        trie_nodes.push_back(trie_root);
-        trie_root.reset();
-        while (!trie_nodes.empty()) {
-            std::shared_ptr<HaffmanTree::TrieNode> cur_node = trie_nodes.back();
-            trie_nodes.back().reset();
-            trie_nodes.pop_back();
-            if (cur_node->left) {
-                trie_nodes.push_back(cur_node->left);
-                cur_node->left.reset();
-            }
-            if (cur_node->right) {
-                trie_nodes.push_back(cur_node->right);
-                cur_node->right.reset();
-            }
-            cur_node.reset();
+void decompressor::Decompress(std::string_view archive_name, const DecompressOptions &options) {
+    Stream reader(archive_name, 'r', true);
+    DecompressArchive(reader, archive_name, options);
+}
+
+std::vector<MemberInfo> decompressor::List(std::string_view archive_name) {
+    Stream reader(archive_name, 'r', true);
+
+    if (!IsBlockArchive(reader)) {
+        return DecompressLegacy(reader, archive_name, {}, true);
+    }
+    if (reader.IsSeekable()) {
+        std::optional<ArchiveIndex> index = ArchiveIndex::Read(reader);
+        if (index.has_value()) {
+            return index->GetMembers();
         }
+        reader.Seek(0);
+    }
+    return DecompressBlocks(reader, archive_name, {}, true);
+}
+
+void decompressor::Extract(std::string_view archive_name, const DecompressOptions &options) {
+    Stream reader(archive_name, 'r', true);
+    std::optional<ArchiveIndex> index;
+    if (IsBlockArchive(reader) && reader.IsSeekable()) {
+        index = ArchiveIndex::Read(reader);
+        reader.Seek(0);
+    }
+    if (!index.has_value()) {
+        DecompressArchive(reader, archive_name, options);
+        return;
     }
+
+    auto wrong_format_error =
+        std::runtime_error("File " + std::string(archive_name) + " has wrong decompressed file format!");
+    BlockArchiveHeader header = ReadBlockArchiveHeader(reader, wrong_format_error);
+
+    std::unique_ptr<ThreadPool> pool;
+    if (options.threads != 1) {
+        pool = std::make_unique<ThreadPool>(options.threads);
+    }
+    for (const std::string &name : options.members) {
+        const MemberInfo *member = index->FindMember(name);
+        if (!member) {
+            throw std::runtime_error("File " + name + " not found in archive " + std::string(archive_name));
+        }
+        reader.Seek(member->offset);
+        size_t tag = reader.ReadUInt(8);
+        if (tag == SOLID_TAG) {
+            DecompressOptions member_options = options;
+            member_options.members = {name};
+            DecompressSolidGroup(reader, member->offset, header, pool.get(), member_options, false,
+                                 wrong_format_error);
+            continue;
+        }
+        if (tag != MEMBER_TAG || ReadMemberName(reader, wrong_format_error) != member->name) {
+            throw wrong_format_error;
+        }
+        Crc32c record_checksum;
+        if (header.has_record_checksums) {
+            UpdateRecordChecksum(record_checksum, member->name);
+        }
+        MemberSink sink = OpenMember(member->name, options);
+        DecompressMemberBlocks(reader, &sink, header, record_checksum, pool.get(), member->name, wrong_format_error);
+    }
+}
+
+std::vector<MemberInfo> decompressor::Test(std::string_view archive_name, const DecompressOptions &options) {
+    DecompressOptions test_options = options;
+    test_options.output = [](const std::string &) { return MemberSink([](std::span<const char>) {}); };
+    Stream reader(archive_name, 'r', true);
+    return DecompressArchive(reader, archive_name, test_options);
 }
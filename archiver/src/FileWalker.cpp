@@ -0,0 +1,114 @@
+#include "FileWalker.h"
+#include "PathUtils.h"
+#include "Stream.h"
+#include <algorithm>
+
+FileWalker::FileWalker(const std::vector<std::string_view> &paths,
+                       const std::vector<std::string_view> &skipped_paths, size_t max_queue_size)
+    : paths_(paths.begin(), paths.end()),
+      skipped_paths_(skipped_paths.begin(), skipped_paths.end()),
+      max_queue_size_(std::max<size_t>(max_queue_size, 1)) {
+    thread_ = std::thread([this] { Walk(); });
+}
+
+FileWalker::~FileWalker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    not_full_.notify_all();
+    thread_.join();
+}
+
+void FileWalker::Walk() {
+    try {
+        for (const std::string &path : paths_) {
+            std::error_code error;
+            if (path == Stream::STANDARD_STREAM_NAME || !std::filesystem::is_directory(path, error)) {
+                if (!Push({.path = path, .name = std::string(GetFilename(path))})) {
+                    return;
+                }
+                continue;
+            }
+            std::filesystem::path directory = std::filesystem::path(path).lexically_normal();
+            if (!directory.has_filename()) {
+                directory = directory.parent_path();
+            }
+            std::string name_prefix = directory.filename().string();
+            if (name_prefix == "." || name_prefix == ".." || name_prefix == "/" || name_prefix.empty()) {
+                name_prefix.clear();
+            } else {
+                name_prefix += '/';
+            }
+            if (!WalkDirectory(path, name_prefix)) {
+                return;
+            }
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+    }
+    not_empty_.notify_all();
+}
+
+bool FileWalker::WalkDirectory(const std::filesystem::path &directory, const std::string &name_prefix) {
+    // Entries are sorted so that the archive does not depend on the order the file system returns them in.
+    std::vector<std::filesystem::directory_entry> entries(std::filesystem::directory_iterator(directory), {});
+    std::sort(entries.begin(), entries.end());
+    for (const std::filesystem::directory_entry &entry : entries) {
+        std::string name = name_prefix + entry.path().filename().string();
+        if (entry.is_directory() && !entry.is_symlink()) {
+            if (!WalkDirectory(entry.path(), name + '/')) {
+                return false;
+            }
+        } else if (entry.is_regular_file()) {
+            bool is_skipped = std::any_of(skipped_paths_.begin(), skipped_paths_.end(),
+                                          [&entry](const std::filesystem::path &skipped_path) {
+                                              std::error_code error;
+                                              return std::filesystem::equivalent(entry.path(), skipped_path, error);
+                                          });
+            if (is_skipped) {
+                continue;
+            }
+            if (!Push({.path = entry.path().string(), .name = std::move(name)})) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool FileWalker::Push(InputFile file) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return stopped_ || queue_.size() < max_queue_size_; });
+        if (stopped_) {
+            return false;
+        }
+        queue_.push_back(std::move(file));
+    }
+    not_empty_.notify_one();
+    return true;
+}
+
+std::optional<InputFile> FileWalker::Next() {
+    std::optional<InputFile> file;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return done_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            if (error_) {
+                std::rethrow_exception(error_);
+            }
+            return std::nullopt;
+        }
+        file = std::move(queue_.front());
+        queue_.pop_front();
+    }
+    not_full_.notify_one();
+    return file;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct InputFile {
+    std::string path;
+    std::string name;
+};
+
+class FileWalker {
+private:
+    std::vector<std::string> paths_;
+    std::vector<std::filesystem::path> skipped_paths_;
+    std::deque<InputFile> queue_;
+    size_t max_queue_size_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    bool done_ = false;
+    bool stopped_ = false;
+    std::exception_ptr error_;
+    std::thread thread_;
+
+    void Walk();
+
+    bool WalkDirectory(const std::filesystem::path &directory, const std::string &name_prefix);
+
+    bool Push(InputFile file);
+
+public:
+    static constexpr size_t DEFAULT_QUEUE_SIZE = 256;
+
+    explicit FileWalker(const std::vector<std::string_view> &paths,
+                        const std::vector<std::string_view> &skipped_paths = {},
+                        size_t max_queue_size = DEFAULT_QUEUE_SIZE);
+
+    FileWalker(const FileWalker &) = delete;
+
+    FileWalker &operator=(const FileWalker &) = delete;
+
+    ~FileWalker();
+
+    std::optional<InputFile> Next();
+};
@@ -0,0 +1,103 @@
+#include "HaffmanDecoder.h"
+#include <algorithm>
+
+HaffmanDecoder::CodeTable HaffmanDecoder::BuildCodeTable(const std::vector<std::pair<size_t, size_t>> &symbols) {
+    CodeTable code_table;
+    uint64_t code = 0;
+    size_t prev_length = 0;
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        auto [char_num, length] = symbols[i];
+        if (char_num >= code_table.size() || code_table[char_num].length > 0 || length == 0 ||
+            length < prev_length || length > MAX_CODE_LENGTH) {
+            throw std::runtime_error("Kanonic codes can't be built!");
+        }
+        if (i > 0) {
+            ++code;
+        }
+        code <<= (length - prev_length);
+        if (code >> length) {
+            throw std::runtime_error("Kanonic codes can't be built!");
+        }
+        code_table[char_num] = {code, static_cast<uint8_t>(length)};
+        prev_length = length;
+    }
+    return code_table;
+}
+
+HaffmanDecoder::HaffmanDecoder(const std::vector<std::pair<size_t, size_t>> &symbols) {
+    Restore(symbols);
+}
+
+void HaffmanDecoder::Restore(const std::vector<std::pair<size_t, size_t>> &symbols) {
+    max_length_ = 0;
+    for (auto &[char_num, length] : symbols) {
+        max_length_ = std::max(max_length_, length);
+    }
+    if (max_length_ > MAX_CODE_LENGTH) {
+        throw std::runtime_error("Kanonic codes longer than " + std::to_string(MAX_CODE_LENGTH) +
+                                 " bits are not supported!");
+    }
+    CodeTable code_table = BuildCodeTable(symbols);
+    lookup_bits_ = std::clamp<size_t>(max_length_, 1, LOOKUP_BITS);
+    lookup_.assign(size_t{1} << lookup_bits_, Entry{});
+    sorted_symbols_.clear();
+    is_byte_alphabet_ = true;
+    first_code_.assign(max_length_ + 1, 0);
+    first_index_.assign(max_length_ + 1, 0);
+    length_count_.assign(max_length_ + 1, 0);
+
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        size_t char_num = symbols[i].first;
+        auto [code, length] = code_table[char_num];
+        if (length_count_[length] == 0) {
+            first_code_[length] = code;
+            first_index_[length] = i;
+        }
+        ++length_count_[length];
+        sorted_symbols_.push_back(char_num);
+        is_byte_alphabet_ = is_byte_alphabet_ && char_num <= UINT8_MAX;
+
+        if (length <= lookup_bits_) {
+            size_t shift = lookup_bits_ - length;
+            for (size_t suffix = 0; suffix < (size_t{1} << shift); ++suffix) {
+                Entry &entry = lookup_[(code << shift) | suffix];
+                entry.symbol = static_cast<uint16_t>(char_num);
+                entry.length = length;
+            }
+        }
+    }
+}
+
+std::optional<size_t> HaffmanDecoder::Decode(Stream &reader) const {
+    const Entry &entry = lookup_[reader.Peek(lookup_bits_)];
+    if (entry.length > 0) {
+        if (reader.BufferedBits() < entry.length) {
+            return std::nullopt;
+        }
+        reader.Consume(entry.length);
+        return entry.symbol;
+    }
+    for (size_t length = lookup_bits_ + 1; length <= max_length_; ++length) {
+        uint64_t offset = reader.Peek(length) - first_code_[length];
+        if (offset < length_count_[length]) {
+            if (reader.BufferedBits() < length) {
+                return std::nullopt;
+            }
+            reader.Consume(length);
+            return sorted_symbols_[first_index_[length] + offset];
+        }
+    }
+    return std::nullopt;
+}
+
+bool HaffmanDecoder::DecodeLongCode(BitReader &reader, char &output) const {
+    for (size_t length = lookup_bits_ + 1; length <= max_length_; ++length) {
+        uint64_t offset = reader.Peek(length) - first_code_[length];
+        if (offset < length_count_[length]) {
+            reader.Consume(length);
+            output = static_cast<char>(sorted_symbols_[first_index_[length] + offset]);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+#include "Stream.h"
+
+class HaffmanDecoder {
+public:
+    static constexpr size_t ALPHABET_SIZE = 259;
+
+    struct Code {
+        uint64_t code = 0;
+        uint8_t length = 0;
+    };
+
+    using CodeTable = std::array<Code, ALPHABET_SIZE>;
+
+private:
+    struct Entry {
+        uint16_t symbol = 0;
+        uint8_t length = 0;
+    };
+
+    // Minimal MSB-first reader over a byte span for the block decoding loop. The whole state lives in
+    // registers, so several readers can advance independently of each other.
+    class BitReader {
+    private:
+        const unsigned char *position_;
+        const unsigned char *end_;
+        size_t padding_bits_ = 0;
+        uint64_t bits_ = 0;
+        size_t count_ = 0;
+
+    public:
+        explicit BitReader(std::span<const char> data, size_t bits_offset = 0)
+            : position_(reinterpret_cast<const unsigned char *>(data.data()) + std::min(bits_offset / 8, data.size())),
+              end_(reinterpret_cast<const unsigned char *>(data.data()) + data.size()) {
+            Refill();
+            Consume(bits_offset % 8);
+        }
+
+        void Refill() {
+            if (end_ - position_ >= static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+                uint64_t word = 0;
+                std::memcpy(&word, position_, sizeof(word));
+                if constexpr (std::endian::native == std::endian::little) {
+                    word = __builtin_bswap64(word);
+                }
+                bits_ |= word >> count_;
+                size_t bytes = (63 - count_) >> 3;
+                position_ += bytes;
+                count_ += bytes << 3;
+                return;
+            }
+            for (; count_ <= 56; count_ += 8) {
+                if (position_ < end_) {
+                    bits_ |= static_cast<uint64_t>(*position_++) << (56 - count_);
+                } else {
+                    padding_bits_ += 8;
+                }
+            }
+        }
+
+        size_t Count() const {
+            return count_;
+        }
+
+        uint64_t Peek(size_t bits) const {
+            return bits_ >> (64 - bits);
+        }
+
+        void Consume(size_t bits) {
+            bits_ <<= bits;
+            count_ -= bits;
+        }
+
+        bool IsOverrun() const {
+            return count_ < padding_bits_;
+        }
+    };
+
+    template <size_t N>
+    bool DecodeStreams(const std::array<std::span<const char>, N> &inputs, const std::array<size_t, N> &bits_offsets,
+                       const std::array<std::span<char>, N> &outputs) const;
+
+    bool DecodeLongCode(BitReader &reader, char &output) const;
+
+    std::vector<Entry> lookup_;
+    std::vector<size_t> sorted_symbols_;
+    std::vector<uint64_t> first_code_;
+    std::vector<size_t> first_index_;
+    std::vector<size_t> length_count_;
+    size_t max_length_ = 0;
+    size_t lookup_bits_ = 0;
+    bool is_byte_alphabet_ = true;
+
+public:
+    static constexpr size_t LOOKUP_BITS = 11;
+    static constexpr size_t MAX_CODE_LENGTH = Stream::MAX_PEEK_BITS;
+
+    static CodeTable BuildCodeTable(const std::vector<std::pair<size_t, size_t>> &symbols);
+
+    HaffmanDecoder() = default;
+
+    explicit HaffmanDecoder(const std::vector<std::pair<size_t, size_t>> &symbols);
+
+    // Rebuilds the decoder for new canonical codes, reusing the storage of its tables.
+    void Restore(const std::vector<std::pair<size_t, size_t>> &symbols);
+
+    std::optional<size_t> Decode(Stream &reader) const;
+
+    // Fills output with bytes decoded from input starting at bits_offset. Returns false if the input
+    // is truncated or holds a code that is not a byte.
+    bool DecodeBytes(std::span<const char> input, size_t bits_offset, std::span<char> output) const {
+        return is_byte_alphabet_ && DecodeStreams<1>({input}, {bits_offset}, {output});
+    }
+
+    // Same as DecodeBytes for N byte-aligned streams, which are stepped in lockstep.
+    template <size_t N>
+    bool DecodeInterleaved(const std::array<std::span<const char>, N> &inputs,
+                           const std::array<std::span<char>, N> &outputs) const {
+        return is_byte_alphabet_ && DecodeStreams<N>(inputs, {}, outputs);
+    }
+};
+
+template <size_t N>
+bool HaffmanDecoder::DecodeStreams(const std::array<std::span<const char>, N> &inputs,
+                                   const std::array<size_t, N> &bits_offsets,
+                                   const std::array<std::span<char>, N> &outputs) const {
+    // Everything the loop touches is copied into locals: output bytes may alias any memory, so
+    // reading members or the spans on every iteration would force reloads after each store.
+    std::array<BitReader, N> readers = [&]<size_t... I>(std::index_sequence<I...>) {
+        return std::array<BitReader, N>{BitReader(inputs[I], bits_offsets[I])...};
+    }(std::make_index_sequence<N>());
+    std::array<char *, N> output_data;
+    size_t common_size = outputs[0].size();
+    for (size_t i = 0; i < N; ++i) {
+        output_data[i] = outputs[i].data();
+        common_size = std::min(common_size, outputs[i].size());
+    }
+    const Entry *lookup = lookup_.data();
+    size_t lookup_bits = lookup_bits_;
+    auto decode = [this, lookup, lookup_bits](BitReader &reader, char &output) {
+        Entry entry = lookup[reader.Peek(lookup_bits)];
+        if (entry.length > 0) [[likely]] {
+            reader.Consume(entry.length);
+            output = static_cast<char>(entry.symbol);
+            return true;
+        }
+        return DecodeLongCode(reader, output);
+    };
+
+    // A refill leaves at least 56 bits in a reader, enough for several codes of bounded length.
+    size_t symbols_per_refill = std::max<size_t>(1, 56 / std::max<size_t>(max_length_, 1));
+    for (size_t j = 0; j < common_size; j += symbols_per_refill) {
+        for (BitReader &reader : readers) {
+            reader.Refill();
+        }
+        size_t last = std::min(j + symbols_per_refill, common_size);
+        for (size_t k = j; k < last; ++k) {
+            for (size_t i = 0; i < N; ++i) {
+                if (!decode(readers[i], output_data[i][k])) {
+                    return false;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = common_size; j < outputs[i].size(); ++j) {
+            readers[i].Refill();
+            if (!decode(readers[i], output_data[i][j])) {
+                return false;
+            }
+        }
+        if (readers[i].IsOverrun()) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -1,89 +1,144 @@
 #include "HaffmanTree.h"
 
-HaffmanTree::Node::Node(size_t char_num, size_t count) {
-    this->char_num = char_num;
-    this->count = count;
+bool HaffmanTree::NodeGreater(size_t a, size_t b) const {
+    if (nodes_[a].count != nodes_[b].count) {
+        return nodes_[a].count > nodes_[b].count;
+    }
+    return nodes_[a].char_num > nodes_[b].char_num;
+}
+
+HaffmanTree::HaffmanTree(const Frequencies &counts, size_t max_code_length) {
+    Build(counts, max_code_length);
 }
 
-bool HaffmanTree::NodePtrCmp::operator()(const std::shared_ptr<HaffmanTree::Node> &a,
-                                         const std::shared_ptr<HaffmanTree::Node> &b) const {
-    if (a->count != b->count) {
-        return a->count < b->count;
+void HaffmanTree::Build(const Frequencies &counts, size_t max_code_length) {
+    if (max_code_length < MIN_CODE_LENGTH_LIMIT || max_code_length > HaffmanDecoder::MAX_CODE_LENGTH) {
+        throw std::runtime_error("Maximum code length must be between " + std::to_string(MIN_CODE_LENGTH_LIMIT) +
+                                 " and " + std::to_string(HaffmanDecoder::MAX_CODE_LENGTH) + " bits!");
+    }
+    leaves_count_ = 0;
+    symbol_lenghts_.fill(0);
+    haffman_codes_.clear();
+    for (size_t char_num = 0; char_num < counts.size(); ++char_num) {
+        if (counts[char_num] > 0) {
+            nodes_[leaves_count_++] = {.char_num = char_num, .count = counts[char_num]};
+        }
     }
-    return a->char_num < b->char_num;
+    if (leaves_count_ == 0) {
+        throw std::runtime_error("Haffman tree can't be built!");
+    }
+    BuildTree();
+    BuildHaffmanLength(max_code_length);
+    BuildKanonicCodes();
+}
+
+HaffmanTree::HaffmanTree(const std::unordered_map<size_t, size_t> &counts) : HaffmanTree(ToFrequencies(counts)) {
 }
 
-HaffmanTree::HaffmanTree(const std::unordered_map<size_t, size_t> &counts) {
+HaffmanTree::Frequencies HaffmanTree::ToFrequencies(const std::unordered_map<size_t, size_t> &counts) {
+    Frequencies frequencies{};
     for (auto &[char_num, count] : counts) {
-        current_nodes_.Push(std::make_shared<Node>(char_num, count));
+        if (char_num >= frequencies.size()) {
+            throw std::runtime_error("Haffman tree can't be built!");
+        }
+        frequencies[char_num] = count;
     }
-    root_ = BuildTree();
-    BuildHaffmanLength();
-    BuildKanonicCodes();
+    return frequencies;
 }
 
-std::shared_ptr<HaffmanTree::Node> HaffmanTree::BuildTree() {
-    while (current_nodes_.Size() > 1) {
-        std::shared_ptr<Node> a = current_nodes_.Top();
-        current_nodes_.Pop();
-        std::shared_ptr<Node> b = current_nodes_.Top();
-        current_nodes_.Pop();
-        std::shared_ptr<Node> new_node(new Node(std::min(a->char_num, b->char_num), a->count + b->count));
-        new_node->left = a;
-        new_node->right = b;
-        a.reset();
-        b.reset();
-        current_nodes_.Push(new_node);
-    }
-    return current_nodes_.Top();
+void HaffmanTree::BuildTree() {
+    // Nodes are appended in merge order, so every parent is stored after both of its children.
+    std::array<uint16_t, ALPHABET_SIZE> leaves;
+    for (size_t i = 0; i < leaves_count_; ++i) {
+        leaves[i] = static_cast<uint16_t>(i);
+    }
+    auto less = [this](uint16_t a, uint16_t b) { return NodeGreater(b, a); };
+    PriorityQueue<uint16_t, decltype(less), HEAP_ARITY, FixedVector<uint16_t, ALPHABET_SIZE>> heap(less);
+    heap.Heapify(leaves.begin(), leaves.begin() + leaves_count_);
+
+    nodes_count_ = leaves_count_;
+    while (heap.Size() > 1) {
+        size_t a = heap.PopTop();
+        size_t b = heap.PopTop();
+
+        nodes_[nodes_count_] = {.char_num = std::min(nodes_[a].char_num, nodes_[b].char_num),
+                                .count = nodes_[a].count + nodes_[b].count};
+        nodes_[a].parent = nodes_count_;
+        nodes_[b].parent = nodes_count_;
+        heap.Push(static_cast<uint16_t>(nodes_count_++));
+    }
+}
+
+void HaffmanTree::BuildHaffmanLength(size_t max_code_length) {
+    std::array<size_t, MAX_NODES_COUNT> depths;
+    size_t root = nodes_count_ - 1;
+    depths[root] = 0;
+    for (size_t i = root; i-- > 0;) {
+        depths[i] = depths[nodes_[i].parent] + 1;
+    }
+
+    size_t max_length = 0;
+    for (size_t i = 0; i < leaves_count_; ++i) {
+        symbol_lenghts_[nodes_[i].char_num] = std::max<size_t>(depths[i], 1);
+        max_length = std::max(max_length, depths[i]);
+    }
+    if (max_length > max_code_length) {
+        LimitHaffmanLength(max_code_length);
+    }
 }
 
-void HaffmanTree::BuildHaffmanLength() {
-    std::queue<std::pair<size_t, std::shared_ptr<Node>>> node_queue;
-    node_queue.push({0, root_});
-    while (!node_queue.empty()) {
-        auto current = node_queue.front();
-        node_queue.pop();
-        if (!current.second->left && !current.second->right) {
-            symbol_lenghts_[current.second->char_num] = current.first;
-        } else {
-            if (!current.second->left || !current.second->right) {
-                throw std::runtime_error("Haffman tree can't be built!");
+void HaffmanTree::LimitHaffmanLength(size_t max_code_length) {
+    std::array<size_t, HaffmanDecoder::MAX_CODE_LENGTH + 1> length_counts{};
+    for (size_t i = 0; i < leaves_count_; ++i) {
+        ++length_counts[std::min(symbol_lenghts_[nodes_[i].char_num], max_code_length)];
+    }
+
+    // Clamping overfills the code space; every step moves one code up from the longest level and
+    // splits a shorter one, which frees exactly one slot of 2^-max_code_length.
+    uint64_t kraft_sum = 0;
+    for (size_t length = 1; length <= max_code_length; ++length) {
+        kraft_sum += static_cast<uint64_t>(length_counts[length]) << (max_code_length - length);
+    }
+    for (; kraft_sum > (uint64_t{1} << max_code_length); --kraft_sum) {
+        --length_counts[max_code_length];
+        for (size_t length = max_code_length - 1; length > 0; --length) {
+            if (length_counts[length] > 0) {
+                --length_counts[length];
+                length_counts[length + 1] += 2;
+                break;
             }
-            node_queue.push({current.first + 1, current.second->left});
-            node_queue.push({current.first + 1, current.second->right});
         }
     }
-}
 
-void HaffmanTree::BuildKanonicCodes() {
-    for (auto &[char_num, length] : symbol_lenghts_) {
-        haffman_codes_.push_back({char_num, length});
+    std::array<uint16_t, ALPHABET_SIZE> leaves;
+    for (size_t i = 0; i < leaves_count_; ++i) {
+        leaves[i] = static_cast<uint16_t>(i);
     }
-    std::sort(haffman_codes_.begin(), haffman_codes_.end(), KanonicSort);
-    std::vector<bool> current_str = {false};
-    for (size_t i = 0; i < haffman_codes_.size(); ++i) {
-        if (i > 0) {
-            AddBinOne(current_str);
+    std::sort(leaves.begin(), leaves.begin() + leaves_count_, [this](uint16_t a, uint16_t b) {
+        if (nodes_[a].count != nodes_[b].count) {
+            return nodes_[a].count > nodes_[b].count;
         }
-        while (current_str.size() < symbol_lenghts_[haffman_codes_[i].first]) {
-            current_str.push_back(false);
+        return nodes_[a].char_num < nodes_[b].char_num;
+    });
+    size_t length = 1;
+    for (size_t i = 0; i < leaves_count_; ++i) {
+        while (length_counts[length] == 0) {
+            ++length;
         }
-        kanonic_codes_[haffman_codes_[i].first] = current_str;
+        --length_counts[length];
+        symbol_lenghts_[nodes_[leaves[i]].char_num] = length;
     }
 }
 
-void HaffmanTree::AddBinOne(std::vector<bool> &bin) {
-    size_t index0 = bin.size();
-    while (index0 > 0 && bin[index0 - 1]) {
-        --index0;
-        bin[index0] = false;
-    }
-    if (index0 > 0) {
-        bin[index0 - 1] = true;
-    } else {
-        throw std::runtime_error("Kanonic codes can't be built!");
+void HaffmanTree::BuildKanonicCodes() {
+    haffman_codes_.reserve(leaves_count_);
+    for (size_t char_num = 0; char_num < symbol_lenghts_.size(); ++char_num) {
+        if (symbol_lenghts_[char_num] > 0) {
+            haffman_codes_.push_back({char_num, symbol_lenghts_[char_num]});
+        }
     }
+    std::sort(haffman_codes_.begin(), haffman_codes_.end(), KanonicSort);
+    code_table_ = HaffmanDecoder::BuildCodeTable(haffman_codes_);
 }
 
 bool HaffmanTree::KanonicSort(const std::pair<size_t, size_t> &a, const std::pair<size_t, size_t> &b) {
@@ -93,39 +148,26 @@ bool HaffmanTree::KanonicSort(const std::pair<size_t, size_t> &a, const std::pai
     return a.first < b.first;
 }
 
-std::unordered_map<size_t, std::vector<bool>> &HaffmanTree::GetKanonicCodes() {
-    return kanonic_codes_;
+const HaffmanTree::CodeTable &HaffmanTree::GetCodeTable() const {
+    return code_table_;
 }
 
-std::shared_ptr<HaffmanTree::TrieNode> HaffmanTree::RestoreKanonicCodes(
-    std::vector<std::pair<size_t, size_t>> &symbols) {
-    std::vector<bool> current_str = {false};
-    auto root = std::shared_ptr<TrieNode>(new TrieNode());
-
-    for (size_t i = 0; i < symbols.size(); ++i) {
-        if (i > 0) {
-            AddBinOne(current_str);
-        }
-        while (current_str.size() < symbols[i].second) {
-            current_str.push_back(false);
-        }
-        auto cur_node = root;
-        for (const bool &bit : current_str) {
-            if (!bit) {
-                if (!cur_node->left) {
-                    cur_node->left = std::shared_ptr<TrieNode>(new TrieNode());
-                }
-                cur_node = cur_node->left;
-            } else {
-                if (!cur_node->right) {
-                    cur_node->right = std::shared_ptr<TrieNode>(new TrieNode());
-                }
-                cur_node = cur_node->right;
+std::unordered_map<size_t, std::vector<bool>> HaffmanTree::GetKanonicCodes() const {
+    std::unordered_map<size_t, std::vector<bool>> kanonic_codes;
+    for (size_t char_num = 0; char_num < code_table_.size(); ++char_num) {
+        auto [code, length] = code_table_[char_num];
+        if (length > 0) {
+            std::vector<bool> &bits = kanonic_codes[char_num];
+            for (size_t i = length; i-- > 0;) {
+                bits.push_back((code >> i) & 1);
             }
         }
-        cur_node->code = symbols[i].first;
     }
-    return root;
+    return kanonic_codes;
+}
+
+HaffmanDecoder HaffmanTree::RestoreKanonicCodes(const std::vector<std::pair<size_t, size_t>> &symbols) {
+    return HaffmanDecoder(symbols);
 }
 
 std::vector<std::pair<size_t, size_t>> &HaffmanTree::GetHaffmanCodes() {
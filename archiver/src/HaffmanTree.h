@@ -1,56 +1,69 @@
 #pragma once
 #include <iostream>
-#include <set>
 #include <vector>
-#include <queue>
 #include <algorithm>
-#include <memory>
-#include <optional>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include "HaffmanDecoder.h"
 #include "PriorityQueue.h"
 
 class HaffmanTree {
+public:
+    static constexpr size_t ALPHABET_SIZE = HaffmanDecoder::ALPHABET_SIZE;
+    static constexpr size_t MAX_NODES_COUNT = 2 * ALPHABET_SIZE - 1;
+    static constexpr size_t MIN_CODE_LENGTH_LIMIT = 9;
+    static constexpr size_t DEFAULT_MAX_CODE_LENGTH = 15;
+    // Arity of the heap of nodes: a 4-ary heap is half as deep, and its children share a cache line. The heap
+    // holds at most ALPHABET_SIZE nodes and is stored in place, so building a tree does not allocate.
+    static constexpr size_t HEAP_ARITY = 4;
+
+    using Frequencies = std::array<size_t, ALPHABET_SIZE>;
+    using CodeTable = HaffmanDecoder::CodeTable;
+
 private:
     struct Node {
-        size_t char_num;
-        size_t count;
-        std::shared_ptr<Node> right = nullptr;
-        std::shared_ptr<Node> left = nullptr;
-
-        Node(size_t char_num, size_t count);
+        size_t char_num = 0;
+        size_t count = 0;
+        size_t parent = 0;
     };
 
-    struct NodePtrCmp {
-        bool operator()(const std::shared_ptr<HaffmanTree::Node> &a, const std::shared_ptr<HaffmanTree::Node> &b) const;
-    };
+    std::array<Node, MAX_NODES_COUNT> nodes_;
+    std::array<size_t, ALPHABET_SIZE> symbol_lenghts_{};
+    size_t leaves_count_ = 0;
+    size_t nodes_count_ = 0;
+    std::vector<std::pair<size_t, size_t>> haffman_codes_;
+    CodeTable code_table_;
 
-    std::shared_ptr<HaffmanTree::Node> BuildTree();
+    bool NodeGreater(size_t a, size_t b) const;
 
-    PriorityQueue<std::shared_ptr<Node>, NodePtrCmp> current_nodes_;
-    std::shared_ptr<Node> root_;
-    std::vector<std::pair<size_t, size_t>> haffman_codes_;
-    std::unordered_map<size_t, std::vector<bool>> kanonic_codes_;
-    std::unordered_map<size_t, size_t> symbol_lenghts_;
+    void BuildTree();
 
-    static void AddBinOne(std::vector<bool> &str);
+    void BuildHaffmanLength(size_t max_code_length);
 
-    void BuildHaffmanLength();
+    void LimitHaffmanLength(size_t max_code_length);
 
     void BuildKanonicCodes();
 
 public:
+    static Frequencies ToFrequencies(const std::unordered_map<size_t, size_t> &counts);
+
+    HaffmanTree() = default;
+
+    explicit HaffmanTree(const Frequencies &counts, size_t max_code_length = HaffmanDecoder::MAX_CODE_LENGTH);
+
+    // Rebuilds the tree for new counts, reusing the storage of the previous codes.
+    void Build(const Frequencies &counts, size_t max_code_length = HaffmanDecoder::MAX_CODE_LENGTH);
+
     explicit HaffmanTree(const std::unordered_map<size_t, size_t> &counts);
 
-    std::unordered_map<size_t, std::vector<bool>> &GetKanonicCodes();
+    const CodeTable &GetCodeTable() const;
+
+    std::unordered_map<size_t, std::vector<bool>> GetKanonicCodes() const;
 
     std::vector<std::pair<size_t, size_t>> &GetHaffmanCodes();
 
     static bool KanonicSort(const std::pair<size_t, size_t> &a, const std::pair<size_t, size_t> &b);
 
-    struct TrieNode {
-        std::optional<size_t> code;
-        std::shared_ptr<TrieNode> right = nullptr;
-        std::shared_ptr<TrieNode> left = nullptr;
-    };
-
-    static std::shared_ptr<TrieNode> RestoreKanonicCodes(std::vector<std::pair<size_t, size_t>> &symbols);
-};
\ No newline at end of file
+    static HaffmanDecoder RestoreKanonicCodes(const std::vector<std::pair<size_t, size_t>> &symbols);
+};
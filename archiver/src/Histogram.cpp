@@ -0,0 +1,66 @@
+#include "Histogram.h"
+#include <array>
+#include <cstdint>
+#include <future>
+
+void Histogram::CountBytes(std::span<const char> data) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data.data());
+    while (!data.empty()) {
+        size_t slice_size = std::min(data.size(), MAX_SLICE_SIZE);
+        std::array<std::array<uint32_t, 256>, TABLES_COUNT> tables{};
+        size_t i = 0;
+        for (; i + TABLES_COUNT <= slice_size; i += TABLES_COUNT) {
+            ++tables[0][bytes[i]];
+            ++tables[1][bytes[i + 1]];
+            ++tables[2][bytes[i + 2]];
+            ++tables[3][bytes[i + 3]];
+        }
+        for (; i < slice_size; ++i) {
+            ++tables[0][bytes[i]];
+        }
+        for (size_t symbol = 0; symbol < 256; ++symbol) {
+            for (const std::array<uint32_t, 256> &table : tables) {
+                counts_[symbol] += table[symbol];
+            }
+        }
+        bytes += slice_size;
+        data = data.subspan(slice_size);
+    }
+}
+
+void Histogram::Add(size_t symbol, size_t count) {
+    if (symbol >= counts_.size()) {
+        throw std::runtime_error("Symbol " + std::to_string(symbol) + " can't be counted!");
+    }
+    counts_[symbol] += count;
+}
+
+void Histogram::Add(std::span<const char> data, ThreadPool *pool) {
+    if (!pool || pool->Size() < 2 || data.size() < PARALLEL_THRESHOLD) {
+        CountBytes(data);
+        return;
+    }
+    size_t part_size = (data.size() + pool->Size() - 1) / pool->Size();
+    std::vector<std::future<Histogram>> parts;
+    for (size_t offset = 0; offset < data.size(); offset += part_size) {
+        std::span<const char> part = data.subspan(offset, std::min(part_size, data.size() - offset));
+        parts.push_back(pool->Submit([part] {
+            Histogram histogram;
+            histogram.CountBytes(part);
+            return histogram;
+        }));
+    }
+    for (std::future<Histogram> &part : parts) {
+        Merge(part.get());
+    }
+}
+
+void Histogram::Merge(const Histogram &other) {
+    for (size_t symbol = 0; symbol < counts_.size(); ++symbol) {
+        counts_[symbol] += other.counts_[symbol];
+    }
+}
+
+const HaffmanTree::Frequencies &Histogram::GetCounts() const {
+    return counts_;
+}
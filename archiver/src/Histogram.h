@@ -0,0 +1,24 @@
+#pragma once
+#include <span>
+#include "HaffmanTree.h"
+#include "ThreadPool.h"
+
+class Histogram {
+private:
+    HaffmanTree::Frequencies counts_{};
+
+    void CountBytes(std::span<const char> data);
+
+public:
+    static constexpr size_t TABLES_COUNT = 4;
+    static constexpr size_t MAX_SLICE_SIZE = 1 << 30;
+    static constexpr size_t PARALLEL_THRESHOLD = 1 << 22;
+
+    void Add(size_t symbol, size_t count = 1);
+
+    void Add(std::span<const char> data, ThreadPool *pool = nullptr);
+
+    void Merge(const Histogram &other);
+
+    const HaffmanTree::Frequencies &GetCounts() const;
+};
@@ -0,0 +1,43 @@
+#include "PathUtils.h"
+#include "Stream.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+std::string_view GetFilename(std::string_view filepath) {
+    if (filepath == Stream::STANDARD_STREAM_NAME) {
+        return STDIN_MEMBER_NAME;
+    }
+    size_t slash_index = filepath.rfind('/');
+    return filepath.substr(slash_index == std::string_view::npos ? 0 : slash_index + 1);
+}
+
+TemporaryFile::TemporaryFile(std::string_view prefix) {
+    std::random_device device;
+    for (size_t attempt = 0; attempt < MAX_CREATE_ATTEMPTS; ++attempt) {
+        std::ostringstream name;
+        name << prefix << '.' << std::hex << device() << device() << ".tmp";
+        path_ = name.str();
+        std::error_code error;
+        if (std::filesystem::exists(path_, error)) {
+            continue;
+        }
+        std::ofstream file(path_, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Can't create temporary file " + path_);
+        }
+        return;
+    }
+    throw std::runtime_error("Can't create temporary file " + std::string(prefix) + ".*.tmp");
+}
+
+TemporaryFile::~TemporaryFile() {
+    std::error_code error;
+    std::filesystem::remove(path_, error);
+}
+
+const std::string &TemporaryFile::GetPath() const {
+    return path_;
+}
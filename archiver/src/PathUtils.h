@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// Name under which standard input is stored in archives.
+const std::string_view STDIN_MEMBER_NAME = "stdin";
+
+// Returns the member name of an input path: its last component, or STDIN_MEMBER_NAME for "-".
+std::string_view GetFilename(std::string_view filepath);
+
+// An empty file that is removed when the object goes out of scope, also when an exception is thrown. Its
+// name is the prefix followed by a random suffix, so concurrent runs do not share a file.
+class TemporaryFile {
+private:
+    std::string path_;
+
+public:
+    static constexpr size_t MAX_CREATE_ATTEMPTS = 16;
+
+    explicit TemporaryFile(std::string_view prefix);
+
+    TemporaryFile(const TemporaryFile &) = delete;
+
+    TemporaryFile &operator=(const TemporaryFile &) = delete;
+
+    ~TemporaryFile();
+
+    const std::string &GetPath() const;
+};
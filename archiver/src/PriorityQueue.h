@@ -1,25 +1,104 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
-template <typename T, typename K = std::less<T>>
+// Vector-like storage of at most Capacity elements that lives inside the object, for queues that
+// must not touch the heap. Growing past the capacity throws.
+template <typename T, size_t Capacity>
+class FixedVector {
+public:
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    T& operator[](size_t i) {
+        return data_[i];
+    }
+
+    const T& operator[](size_t i) const {
+        return data_[i];
+    }
+
+    T& back() {
+        return data_[size_ - 1];
+    }
+
+    void push_back(T x) {
+        reserve(size_ + 1);
+        data_[size_++] = std::move(x);
+    }
+
+    template <typename... Args>
+    void emplace_back(Args&&... args) {
+        push_back(T(std::forward<Args>(args)...));
+    }
+
+    void pop_back() {
+        --size_;
+    }
+
+    void reserve(size_t size) const {
+        if (size > Capacity) {
+            throw std::runtime_error("Fixed vector capacity exceeded!");
+        }
+    }
+
+private:
+    std::array<T, Capacity> data_{};
+    size_t size_ = 0;
+};
+
+// Container must be std::vector<T> or another type with the same interface, such as FixedVector.
+template <typename T, typename K = std::less<T>, size_t Arity = 2, typename Container = std::vector<T>>
 class PriorityQueue {
+    static_assert(Arity >= 2, "Heap arity must be at least 2");
 
 public:
+    PriorityQueue() = default;
+
+    explicit PriorityQueue(K cmp) : cmp_(std::move(cmp)) {
+    }
+
     void Pop() {
         if (Size() == 0) {
             throw std::runtime_error("Can't pop from empty queue!");
         }
-        std::swap(data_[0], data_[data_.size() - 1]);
+        T last = std::move(data_.back());
         data_.pop_back();
-        SiftDown(0);
+        if (!data_.empty()) {
+            size_t hole = MoveHoleToLeaf(0);
+            data_[hole] = std::move(last);
+            SiftUp(hole);
+        }
+    }
+
+    T PopTop() {
+        if (Size() == 0) {
+            throw std::runtime_error("Can't pop from empty queue!");
+        }
+        T top = std::move(data_[0]);
+        Pop();
+        return top;
     }
 
     size_t Size() const {
         return data_.size();
     }
 
-    const T Top() const {
+    bool Empty() const {
+        return data_.empty();
+    }
+
+    const T& Top() const {
         if (Size() == 0) {
             throw std::runtime_error("Can't get top element from empty queue!");
         }
@@ -27,34 +106,84 @@ public:
     }
 
     void Push(const T& x) {
-        size_t i = data_.size();
         data_.push_back(x);
-        SiftUp(i);
+        SiftUp(data_.size() - 1);
+    }
+
+    void Push(T&& x) {
+        data_.push_back(std::move(x));
+        SiftUp(data_.size() - 1);
+    }
+
+    template <typename... Args>
+    void Emplace(Args&&... args) {
+        data_.emplace_back(std::forward<Args>(args)...);
+        SiftUp(data_.size() - 1);
+    }
+
+    void Reserve(size_t size) {
+        data_.reserve(size);
+    }
+
+    template <typename It>
+    void Heapify(It first, It last) {
+        for (It it = first; it != last; ++it) {
+            data_.push_back(*it);
+        }
+        for (size_t i = data_.size() / Arity + 1; i-- > 0;) {
+            SiftDown(i);
+        }
     }
 
 private:
-    void SiftDown(size_t i) {
-        while (2 * i + 1 < data_.size()) {
-            size_t left = 2 * i + 1;
-            size_t right = 2 * i + 2;
-            size_t j = left;
-            if (right < data_.size() && K()(data_[right], data_[left])) {
-                j = right;
+    size_t BestChild(size_t i) const {
+        size_t first = Arity * i + 1;
+        size_t last = std::min(first + Arity, data_.size());
+        size_t best = first;
+        for (size_t child = first + 1; child < last; ++child) {
+            if (cmp_(data_[child], data_[best])) {
+                best = child;
             }
-            if (K()(data_[i], data_[j])) {
+        }
+        return best;
+    }
+
+    // Pop moves the hole all the way down and then sifts the last element up from there: the last
+    // element almost always belongs near the bottom, so this saves one comparison per level.
+    size_t MoveHoleToLeaf(size_t i) {
+        while (Arity * i + 1 < data_.size()) {
+            size_t j = BestChild(i);
+            data_[i] = std::move(data_[j]);
+            i = j;
+        }
+        return i;
+    }
+
+    void SiftDown(size_t i) {
+        if (i >= data_.size()) {
+            return;
+        }
+        T value = std::move(data_[i]);
+        while (Arity * i + 1 < data_.size()) {
+            size_t j = BestChild(i);
+            if (!cmp_(data_[j], value)) {
                 break;
             }
-            std::swap(data_[i], data_[j]);
+            data_[i] = std::move(data_[j]);
             i = j;
         }
+        data_[i] = std::move(value);
     }
 
     void SiftUp(size_t i) {
-        while (i > 0 && K()(data_[i], data_[(i - 1) / 2])) {
-            std::swap(data_[i], data_[(i - 1) / 2]);
-            i = (i - 1) / 2;
+        T value = std::move(data_[i]);
+        while (i > 0 && cmp_(value, data_[(i - 1) / Arity])) {
+            data_[i] = std::move(data_[(i - 1) / Arity]);
+            i = (i - 1) / Arity;
         }
+        data_[i] = std::move(value);
     }
 
-    std::vector<T> data_;
+    Container data_;
+    K cmp_{};
 };
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <optional>
+#include <utility>
+
+// Bounded single-producer single-consumer queue. TryPush/TryPop never lock; Push/Pop sleep on the
+// indices with atomic wait/notify when the ring is full or empty.
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Ring capacity must be a power of two");
+
+public:
+    bool TryPush(T &value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        items_[tail % Capacity] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        tail_.notify_one();
+        return true;
+    }
+
+    std::optional<T> TryPop() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (tail_.load(std::memory_order_acquire) == head) {
+            return std::nullopt;
+        }
+        std::optional<T> value(std::move(items_[head % Capacity]));
+        head_.store(head + 1, std::memory_order_release);
+        head_.notify_one();
+        return value;
+    }
+
+    void Push(T value) {
+        while (!TryPush(value)) {
+            size_t head = head_.load(std::memory_order_acquire);
+            if (tail_.load(std::memory_order_relaxed) - head == Capacity) {
+                head_.wait(head, std::memory_order_acquire);
+            }
+        }
+    }
+
+    T Pop() {
+        while (true) {
+            std::optional<T> value = TryPop();
+            if (value.has_value()) {
+                return std::move(value.value());
+            }
+            tail_.wait(head_.load(std::memory_order_relaxed), std::memory_order_acquire);
+        }
+    }
+
+private:
+    std::array<T, Capacity> items_;
+    alignas(64) std::atomic<size_t> head_ = 0;
+    alignas(64) std::atomic<size_t> tail_ = 0;
+};
@@ -1,9 +1,126 @@
 #include "Stream.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <thread>
+#include "SpscRing.h"
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define STREAM_HAS_MMAP
+#endif
+
+// Moves file I/O of a stream to a background thread, so that coding does not wait for the disk. The
+// writer thread drains filled buffers, the reader thread fills them ahead of the consumer. Buffers
+// travel between the stream and the thread through two rings, so only PIPELINE_BUFFERS_COUNT of
+// them exist and neither ring can overflow.
+class Stream::Pipeline {
+public:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+        bool is_last = false;
+    };
+
+    Pipeline(std::fstream &stream, char type) : stream_(stream), type_(type) {
+        for (size_t i = 0; i + 1 < PIPELINE_BUFFERS_COUNT; ++i) {
+            free_.Push({.data = std::unique_ptr<char[]>(new char[PIPELINE_BUFFER_SIZE])});
+        }
+        thread_ = std::thread([this] { type_ == 'w' ? WriteLoop() : ReadLoop(); });
+    }
+
+    ~Pipeline() {
+        if (type_ == 'w') {
+            filled_.Push({});
+        } else {
+            stopped_ = true;
+            free_.Push({});
+        }
+        thread_.join();
+    }
+
+    std::unique_ptr<char[]> Write(std::unique_ptr<char[]> data, size_t size) {
+        filled_.Push({.data = std::move(data), .size = size});
+        return free_.Pop().data;
+    }
+
+    Chunk Read(std::unique_ptr<char[]> data) {
+        free_.Push({.data = std::move(data)});
+        return filled_.Pop();
+    }
+
+private:
+    void WriteLoop() {
+        while (true) {
+            Chunk chunk = filled_.Pop();
+            if (!chunk.data) {
+                break;
+            }
+            stream_.write(chunk.data.get(), chunk.size);
+            free_.Push(std::move(chunk));
+        }
+        stream_.flush();
+    }
+
+    void ReadLoop() {
+        while (!stopped_) {
+            Chunk chunk = free_.Pop();
+            if (!chunk.data) {
+                break;
+            }
+            stream_.read(chunk.data.get(), PIPELINE_BUFFER_SIZE);
+            chunk.size = stream_.gcount();
+            chunk.is_last = !stream_.good();
+            bool is_last = chunk.is_last;
+            filled_.Push(std::move(chunk));
+            if (is_last) {
+                break;
+            }
+        }
+    }
+
+    std::fstream &stream_;
+    char type_;
+    std::atomic<bool> stopped_ = false;
+    SpscRing<Chunk, PIPELINE_BUFFERS_COUNT> filled_;
+    SpscRing<Chunk, PIPELINE_BUFFERS_COUNT> free_;
+    std::thread thread_;
+};
 
 Stream::Stream(std::string_view filename, char type, bool is_little_end)
-    : type_(type), little_end_(is_little_end), eof_(false), bits_rem_(0), bytes_cnt_(0), cur_byte_(0) {
+    : type_(type),
+      little_end_(is_little_end),
+      eof_(false),
+      bytes_cnt_(0),
+      cur_byte_(0),
+      bit_buffer_(0),
+      bit_count_(0),
+      buffer_offset_(0),
+      memory_(nullptr),
+      memory_offset_(0),
+      is_fixed_output_(false),
+      output_(nullptr),
+      data_(nullptr),
+      mapping_(nullptr),
+      mapping_size_(0),
+      is_pipelined_(false) {
+    if (filename == STANDARD_STREAM_NAME) {
+        filename = type_ == 'w' ? "/dev/stdout" : "/dev/stdin";
+    }
     std::string filaname_str(filename);
-    if (type_ == 'w') {
+    if (type_ == 'r' && MapFile(filaname_str)) {
+        return;
+    }
+    std::ios::openmode mode = (type_ == 'r' ? std::ios::in : std::ios::out) | std::ios::binary;
+    if (type_ == 'a') {
+        // Appends to an existing file; positions and BitsWritten count from the start of the file.
+        mode |= std::ios::in | std::ios::ate;
+        type_ = 'w';
+    } else if (type_ == 'w') {
         try {
             std::ofstream file(filaname_str);
             file.close();
@@ -11,28 +128,142 @@ Stream::Stream(std::string_view filename, char type, bool is_little_end)
             throw std::runtime_error("Invalid file name " + filaname_str + " for input/output !");
         }
     }
-    stream_.open(filaname_str);
+    stream_.open(filaname_str, mode);
     if (!stream_.is_open() || stream_.bad()) {
         throw std::runtime_error("Can't open file " + filaname_str);
     }
+    if (mode & std::ios::ate) {
+        buffer_offset_ = stream_.tellp();
+    }
+    // Writes and reads from pipes go through a pipeline; it is started only once a whole buffer is
+    // filled or requested, so small files do not pay for a thread.
+    is_pipelined_ = type_ == 'w' || !IsSeekable();
+    if (is_pipelined_) {
+        buffer_size_ = PIPELINE_BUFFER_SIZE;
+    }
     buffer_ = std::unique_ptr<char[]>(new char[buffer_size_]);
-    if (type_ == 'w') {
-        for (size_t j = 0; j < buffer_size_; ++j) {
-            buffer_[j] = 0;
-        }
+    data_ = buffer_.get();
+    output_ = buffer_.get();
+}
+
+Stream::Stream(std::vector<char> &memory)
+    : type_('w'),
+      little_end_(false),
+      eof_(false),
+      bytes_cnt_(0),
+      cur_byte_(0),
+      bit_buffer_(0),
+      bit_count_(0),
+      buffer_offset_(0),
+      memory_(&memory),
+      memory_offset_(memory.size()),
+      is_fixed_output_(false),
+      output_(memory.data() + memory.size()),
+      data_(nullptr),
+      mapping_(nullptr),
+      mapping_size_(0),
+      is_pipelined_(false) {
+    buffer_size_ = 0;
+}
+
+Stream::Stream(std::span<std::byte> output)
+    : type_('w'),
+      little_end_(false),
+      eof_(false),
+      bytes_cnt_(0),
+      cur_byte_(0),
+      bit_buffer_(0),
+      bit_count_(0),
+      buffer_offset_(0),
+      memory_(nullptr),
+      memory_offset_(0),
+      is_fixed_output_(true),
+      output_(reinterpret_cast<char *>(output.data())),
+      data_(nullptr),
+      mapping_(nullptr),
+      mapping_size_(0),
+      is_pipelined_(false) {
+    buffer_size_ = output.size();
+}
+
+Stream::Stream(std::span<const std::byte> data, bool is_little_end)
+    : type_('r'),
+      little_end_(is_little_end),
+      eof_(true),
+      bytes_cnt_(data.size()),
+      cur_byte_(0),
+      bit_buffer_(0),
+      bit_count_(0),
+      buffer_offset_(0),
+      memory_(nullptr),
+      memory_offset_(0),
+      is_fixed_output_(false),
+      output_(nullptr),
+      data_(reinterpret_cast<const char *>(data.data())),
+      mapping_(nullptr),
+      mapping_size_(0),
+      is_pipelined_(false) {
+}
+
+bool Stream::MapFile(const std::string &filename) {
+#ifdef STREAM_HAS_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = file_stat.st_size;
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
     }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    mapping_ = mapping;
+    mapping_size_ = size;
+    data_ = static_cast<const char *>(mapping);
+    bytes_cnt_ = size;
+    eof_ = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::optional<std::span<const char>> Stream::GetContiguousData() const {
+    if (type_ != 'r' || stream_.is_open()) {
+        return std::nullopt;
+    }
+    return std::span<const char>(data_, bytes_cnt_);
 }
 
 void Stream::ReadBuffer() {
-    stream_.read(buffer_.get(), buffer_size_);
-    bytes_cnt_ = stream_.gcount();
-    if (stream_.eof()) {
-        eof_ = true;
+    buffer_offset_ += bytes_cnt_;
+    if (is_pipelined_) {
+        if (!pipeline_) {
+            pipeline_ = std::make_unique<Pipeline>(stream_, type_);
+        }
+        Pipeline::Chunk chunk = pipeline_->Read(std::move(buffer_));
+        buffer_ = std::move(chunk.data);
+        data_ = buffer_.get();
+        bytes_cnt_ = chunk.size;
+        eof_ = chunk.is_last || bytes_cnt_ == 0;
+    } else {
+        stream_.read(buffer_.get(), buffer_size_);
+        bytes_cnt_ = stream_.gcount();
+        eof_ = stream_.eof() || bytes_cnt_ == 0;
     }
     cur_byte_ = 0;
 }
 
 bool Stream::Eof() {
+    if (bit_count_ > 0) {
+        return false;
+    }
     if (eof_) {
         return cur_byte_ == bytes_cnt_;
     }
@@ -40,33 +271,105 @@ bool Stream::Eof() {
         return false;
     }
     ReadBuffer();
-    bits_rem_ = byte_size_;
     return bytes_cnt_ == 0;
 }
 
-void Stream::ReadBits(size_t bits_count, std::vector<bool>& result) {
-    for (size_t i = 0; i < bits_count; ++i) {
-        if (bytes_cnt_ == cur_byte_ && !eof_) {
-            ReadBuffer();
-            bits_rem_ = byte_size_;
+void Stream::FillBitBuffer() {
+    if (cur_byte_ + sizeof(uint64_t) <= bytes_cnt_) {
+        size_t bytes = (64 - bit_count_) / byte_size_;
+        uint64_t word = 0;
+        std::memcpy(&word, data_ + cur_byte_, sizeof(word));
+        if constexpr (std::endian::native == std::endian::little) {
+            word = __builtin_bswap64(word);
         }
-        if (bits_rem_ == 0) {
-            bits_rem_ = byte_size_;
-            ++cur_byte_;
+        word >>= 64 - bytes * byte_size_;
+        bit_buffer_ |= word << (64 - bytes * byte_size_ - bit_count_);
+        bit_count_ += bytes * byte_size_;
+        cur_byte_ += bytes;
+        return;
+    }
+    while (bit_count_ + byte_size_ <= 64) {
+        if (cur_byte_ == bytes_cnt_) {
+            if (eof_) {
+                break;
+            }
+            ReadBuffer();
+            if (bytes_cnt_ == 0) {
+                break;
+            }
         }
-        if (bytes_cnt_ == cur_byte_) {
-            result[i] = false;
-        } else {
-            --bits_rem_;
-            result[i] = ((buffer_[cur_byte_] >> bits_rem_) & 1);
-            if (bits_rem_ == 0) {
-                ++cur_byte_;
-                bits_rem_ = byte_size_;
+        uint64_t byte = static_cast<unsigned char>(data_[cur_byte_++]);
+        bit_buffer_ |= byte << (64 - byte_size_ - bit_count_);
+        bit_count_ += byte_size_;
+    }
+}
+
+size_t Stream::Peek(size_t bits_count) {
+    if (bits_count > MAX_PEEK_BITS) {
+        throw std::runtime_error("Can't peek more than " + std::to_string(MAX_PEEK_BITS) + " bits!");
+    }
+    if (bit_count_ < bits_count) {
+        FillBitBuffer();
+    }
+    if (bits_count == 0) {
+        return 0;
+    }
+    return bit_buffer_ >> (64 - bits_count);
+}
+
+void Stream::Consume(size_t bits_count) {
+    bits_count = std::min(bits_count, bit_count_);
+    bit_buffer_ = bits_count == 64 ? 0 : bit_buffer_ << bits_count;
+    bit_count_ -= bits_count;
+}
+
+size_t Stream::BufferedBits() const {
+    return bit_count_;
+}
+
+size_t Stream::ReadBytes(char *data, size_t size) {
+    if (bit_count_ % byte_size_ != 0) {
+        throw std::runtime_error("Can't read bytes from unaligned stream position!");
+    }
+    size_t read = 0;
+    while (read < size && bit_count_ > 0) {
+        data[read++] = static_cast<char>(bit_buffer_ >> (64 - byte_size_));
+        Consume(byte_size_);
+    }
+    while (read < size) {
+        if (cur_byte_ == bytes_cnt_) {
+            if (eof_) {
+                break;
             }
+            ReadBuffer();
+            continue;
         }
+        size_t chunk = std::min(size - read, bytes_cnt_ - cur_byte_);
+        std::memcpy(data + read, data_ + cur_byte_, chunk);
+        cur_byte_ += chunk;
+        read += chunk;
     }
-    if (little_end_) {
-        std::reverse(result.begin(), result.end());
+    return read;
+}
+
+size_t Stream::ReadUInt(size_t bits_count) {
+    if (bits_count > MAX_PEEK_BITS) {
+        size_t high = ReadUInt(bits_count - MAX_WRITE_BITS);
+        return (high << MAX_WRITE_BITS) | ReadUInt(MAX_WRITE_BITS);
+    }
+    size_t result = Peek(bits_count);
+    Consume(bits_count);
+    return result;
+}
+
+void Stream::ReadBits(size_t bits_count, std::vector<bool>& result) {
+    for (size_t i = 0; i < bits_count; i += MAX_PEEK_BITS) {
+        size_t chunk_size = std::min(MAX_PEEK_BITS, bits_count - i);
+        size_t chunk = ReadUInt(chunk_size);
+        for (size_t j = 0; j < chunk_size; ++j) {
+            bool bit = (chunk >> (chunk_size - 1 - j)) & 1;
+            result[little_end_ ? bits_count - 1 - i - j : i + j] = bit;
+        }
     }
 }
 
@@ -77,71 +380,248 @@ unsigned char Stream::ReadChar() {
     if (bytes_cnt_ == cur_byte_) {
         return 0;
     }
-    return buffer_[cur_byte_++];
+    return data_[cur_byte_++];
 }
 
 void Stream::ResetStream() {
+    Seek(0);
+}
+
+void Stream::Seek(size_t byte_offset) {
+    pipeline_.reset();
+    if (stream_.is_open()) {
+        stream_.clear();
+        stream_.seekg(byte_offset);
+        eof_ = false;
+        bytes_cnt_ = 0;
+        cur_byte_ = 0;
+        buffer_offset_ = byte_offset;
+    } else {
+        cur_byte_ = std::min(byte_offset, bytes_cnt_);
+    }
+    bit_buffer_ = 0;
+    bit_count_ = 0;
+}
+
+size_t Stream::Tell() const {
+    return buffer_offset_ + cur_byte_ - bit_count_ / byte_size_;
+}
+
+size_t Stream::Size() {
+    if (!stream_.is_open()) {
+        return bytes_cnt_;
+    }
+    if (!IsSeekable()) {
+        return 0;
+    }
+    std::streampos position = stream_.tellg();
+    stream_.seekg(0, std::ios::end);
+    size_t size = stream_.tellg();
+    stream_.seekg(position);
+    return size;
+}
+
+bool Stream::IsSeekable() {
+    if (!stream_.is_open()) {
+        return true;
+    }
+    if (is_pipelined_ && type_ == 'r') {
+        return false;
+    }
     stream_.clear();
-    stream_.seekg(0);
-    eof_ = false;
-    bytes_cnt_ = 0;
-    cur_byte_ = 0;
-    bits_rem_ = 0;
+    return stream_.tellg() != std::streampos(-1);
+}
+
+void Stream::Skip(size_t bytes_count) {
+    if (IsSeekable()) {
+        Seek(Tell() + bytes_count);
+        return;
+    }
+    std::vector<char> skipped(std::min(bytes_count, buffer_size_));
+    while (bytes_count > 0) {
+        size_t read = ReadBytes(skipped.data(), std::min(bytes_count, skipped.size()));
+        if (read == 0) {
+            break;
+        }
+        bytes_count -= read;
+    }
 }
 
 Stream::~Stream() {
     if (type_ == 'w') {
-        if (cur_byte_ > 0 || bits_rem_ > 0) {
-            if (bits_rem_ > 0) {
-                ++cur_byte_;
+        // Overflowing a fixed output has already thrown; the bits that do not fit are dropped here.
+        if (is_fixed_output_ && cur_byte_ + (bit_count_ + byte_size_ - 1) / byte_size_ > buffer_size_) {
+            bit_count_ = 0;
+        }
+        FlushBitBuffer();
+        if (bit_count_ > 0) {
+            if (cur_byte_ == buffer_size_) {
+                WriteBuffer();
             }
+            output_[cur_byte_++] = static_cast<char>(bit_buffer_ >> (64 - byte_size_));
+            bit_buffer_ = 0;
+            bit_count_ = 0;
+        }
+        if (memory_) {
+            memory_->resize(memory_offset_ + cur_byte_);
+        } else if (cur_byte_ > 0 && !is_fixed_output_) {
             WriteBuffer();
         }
     }
+    pipeline_.reset();
     buffer_.reset();
     stream_.close();
+#ifdef STREAM_HAS_MMAP
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+    }
+#endif
 }
 
 void Stream::WriteBuffer() {
-    stream_.write(buffer_.get(), cur_byte_);
-    stream_.flush();
-    for (size_t j = 0; j < cur_byte_; ++j) {
-        buffer_[j] = 0;
+    if (memory_) {
+        // The vector is grown in place and trimmed to the written size by the destructor; doubling
+        // keeps the zero-filling of the new tail proportional to the bytes written.
+        memory_->resize(memory_offset_ + cur_byte_ + std::max(cur_byte_, MIN_MEMORY_GROWTH));
+        output_ = memory_->data() + memory_offset_;
+        buffer_size_ = memory_->size() - memory_offset_;
+        return;
+    }
+    if (is_fixed_output_) {
+        throw std::runtime_error("Output buffer is too small for written data!");
     }
+    if (pipeline_ || (is_pipelined_ && cur_byte_ + MAX_WRITE_BITS / byte_size_ > buffer_size_)) {
+        if (!pipeline_) {
+            pipeline_ = std::make_unique<Pipeline>(stream_, type_);
+        }
+        buffer_ = pipeline_->Write(std::move(buffer_), cur_byte_);
+        output_ = buffer_.get();
+    } else {
+        stream_.write(buffer_.get(), cur_byte_);
+    }
+    buffer_offset_ += cur_byte_;
     cur_byte_ = 0;
 }
 
-void Stream::Write(const std::vector<bool>& data) {
-    for (const bool& bit : data) {
-        if (bit) {
-            buffer_[cur_byte_] |= (1 << (byte_size_ - 1 - bits_rem_));
-        }
-        ++bits_rem_;
-        if (bits_rem_ == byte_size_) {
-            ++cur_byte_;
-            bits_rem_ = 0;
-        }
+void Stream::FlushBitBuffer() {
+    while (bit_count_ >= byte_size_) {
         if (cur_byte_ == buffer_size_) {
             WriteBuffer();
         }
+        output_[cur_byte_++] = static_cast<char>(bit_buffer_ >> (64 - byte_size_));
+        bit_buffer_ <<= byte_size_;
+        bit_count_ -= byte_size_;
     }
 }
 
+void Stream::WriteBits(uint64_t data, size_t bits_count) {
+    if (bits_count > MAX_WRITE_BITS) {
+        WriteBits(data >> MAX_WRITE_BITS, bits_count - MAX_WRITE_BITS);
+        bits_count = MAX_WRITE_BITS;
+    }
+    if (bits_count == 0) {
+        return;
+    }
+    data &= (uint64_t{1} << bits_count) - 1;
+    bit_buffer_ |= data << (64 - bit_count_ - bits_count);
+    bit_count_ += bits_count;
+    if (bit_count_ >= MAX_WRITE_BITS) {
+        if (cur_byte_ + 4 > buffer_size_) {
+            WriteBuffer();
+        }
+        output_[cur_byte_] = static_cast<char>(bit_buffer_ >> 56);
+        output_[cur_byte_ + 1] = static_cast<char>(bit_buffer_ >> 48);
+        output_[cur_byte_ + 2] = static_cast<char>(bit_buffer_ >> 40);
+        output_[cur_byte_ + 3] = static_cast<char>(bit_buffer_ >> 32);
+        cur_byte_ += 4;
+        bit_buffer_ <<= MAX_WRITE_BITS;
+        bit_count_ -= MAX_WRITE_BITS;
+    }
+}
+
+void Stream::Write(const std::vector<bool>& data) {
+    uint64_t chunk = 0;
+    size_t chunk_size = 0;
+    for (const bool& bit : data) {
+        chunk = (chunk << 1) | bit;
+        ++chunk_size;
+        if (chunk_size == MAX_WRITE_BITS) {
+            WriteBits(chunk, chunk_size);
+            chunk = 0;
+            chunk_size = 0;
+        }
+    }
+    WriteBits(chunk, chunk_size);
+}
+
 void Stream::WriteByte(const char& data) {
+    if (bit_count_ > 0) {
+        WriteBits(static_cast<unsigned char>(data), byte_size_);
+        return;
+    }
     if (cur_byte_ == buffer_size_) {
         WriteBuffer();
     }
-    buffer_[cur_byte_] = data;
+    output_[cur_byte_] = data;
     ++cur_byte_;
 }
 
-void Stream::WriteNumber(size_t data, size_t bits) {
-    std::vector<bool> bit(bits, false);
+void Stream::AppendBits(const std::vector<char> &data, size_t bits_count) {
+    size_t full_bytes = bits_count / byte_size_;
     size_t i = 0;
-    while (data > 0) {
-        bit[bits - i - 1] = (data & 1);
-        data /= 2;
-        ++i;
+    for (; i + sizeof(uint32_t) <= full_bytes; i += sizeof(uint32_t)) {
+        uint32_t word = 0;
+        std::memcpy(&word, data.data() + i, sizeof(word));
+        if constexpr (std::endian::native == std::endian::little) {
+            word = __builtin_bswap32(word);
+        }
+        WriteBits(word, MAX_WRITE_BITS);
+    }
+    for (; i < full_bytes; ++i) {
+        WriteBits(static_cast<unsigned char>(data[i]), byte_size_);
+    }
+    size_t tail_bits = bits_count % byte_size_;
+    if (tail_bits > 0) {
+        WriteBits(static_cast<unsigned char>(data[full_bytes]) >> (byte_size_ - tail_bits), tail_bits);
+    }
+}
+
+size_t Stream::BitsWritten() const {
+    return (buffer_offset_ + cur_byte_) * byte_size_ + bit_count_;
+}
+
+size_t Stream::BitsRead() const {
+    return (buffer_offset_ + cur_byte_) * byte_size_ - bit_count_;
+}
+
+void Stream::WriteBytes(const char *data, size_t size) {
+    if (bit_count_ % byte_size_ != 0) {
+        for (size_t i = 0; i < size; ++i) {
+            WriteBits(static_cast<unsigned char>(data[i]), byte_size_);
+        }
+        return;
+    }
+    FlushBitBuffer();
+    while (size > 0) {
+        if (cur_byte_ == buffer_size_) {
+            WriteBuffer();
+        }
+        size_t chunk = std::min(size, buffer_size_ - cur_byte_);
+        std::memcpy(output_ + cur_byte_, data, chunk);
+        cur_byte_ += chunk;
+        data += chunk;
+        size -= chunk;
     }
-    Write(bit);
+}
+
+void Stream::AlignToByte() {
+    if (type_ == 'w') {
+        WriteBits(0, (byte_size_ - bit_count_ % byte_size_) % byte_size_);
+    } else {
+        Consume(bit_count_ % byte_size_);
+    }
+}
+
+void Stream::WriteNumber(size_t data, size_t bits) {
+    WriteBits(data, bits);
 }
@@ -2,41 +2,113 @@
 #include <iostream>
 #include <fstream>
 #include <memory>
+#include <optional>
+#include <span>
 #include <vector>
+#include <cstdint>
 
 class Stream {
 private:
+    class Pipeline;
+
     std::fstream stream_;
     char type_;
     bool little_end_;
     bool eof_;
     std::unique_ptr<char[]> buffer_;
-    size_t bits_rem_;
     size_t bytes_cnt_;
     size_t cur_byte_;
+    uint64_t bit_buffer_;
+    size_t bit_count_;
+    size_t buffer_offset_;
+    std::vector<char> *memory_;
+    size_t memory_offset_;
+    bool is_fixed_output_;
+    char *output_;
+    const char *data_;
+    void *mapping_;
+    size_t mapping_size_;
+    std::unique_ptr<Pipeline> pipeline_;
+    bool is_pipelined_;
     const size_t byte_size_ = 8;
-    const size_t buffer_size_ = 1024;
+    size_t buffer_size_ = 1024;
+
+    bool MapFile(const std::string &filename);
+
+    void FillBitBuffer();
+
+    void FlushBitBuffer();
 
 public:
+    static constexpr size_t MAX_PEEK_BITS = 57;
+    static constexpr size_t MAX_WRITE_BITS = 32;
+    static constexpr std::string_view STANDARD_STREAM_NAME = "-";
+    static constexpr size_t PIPELINE_BUFFER_SIZE = 1 << 20;
+    static constexpr size_t PIPELINE_BUFFERS_COUNT = 4;
+    static constexpr size_t MIN_MEMORY_GROWTH = 1024;
+
     explicit Stream(std::string_view filename, char type, bool is_little_end = false);
 
+    // Appends written bytes to memory. They go straight into the vector, which keeps its capacity
+    // between writers, so a reused vector is not reallocated.
+    explicit Stream(std::vector<char> &memory);
+
+    // Writes into output, which must be large enough for everything written; overflowing it throws.
+    explicit Stream(std::span<std::byte> output);
+
+    explicit Stream(std::span<const std::byte> data, bool is_little_end = false);
+
     ~Stream();
 
     void ReadBits(size_t bits_count, std::vector<bool>& result);
 
+    size_t ReadUInt(size_t bits_count);
+
+    size_t ReadBytes(char *data, size_t size);
+
+    size_t Peek(size_t bits_count);
+
+    void Consume(size_t bits_count);
+
+    size_t BufferedBits() const;
+
     unsigned char ReadChar();
 
     void ReadBuffer();
 
+    std::optional<std::span<const char>> GetContiguousData() const;
+
     bool Eof();
 
     void ResetStream();
 
+    void Seek(size_t byte_offset);
+
+    size_t Tell() const;
+
+    size_t Size();
+
+    bool IsSeekable();
+
+    void Skip(size_t bytes_count);
+
     void Write(const std::vector<bool>& bits);
 
+    void WriteBits(uint64_t data, size_t bits_count);
+
     void WriteByte(const char& data);
 
     void WriteBuffer();
 
     void WriteNumber(size_t data, size_t bits);
-};
\ No newline at end of file
+
+    void WriteBytes(const char *data, size_t size);
+
+    void AlignToByte();
+
+    void AppendBits(const std::vector<char> &data, size_t bits_count);
+
+    size_t BitsWritten() const;
+
+    size_t BitsRead() const;
+};
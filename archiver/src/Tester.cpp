@@ -1,7 +1,41 @@
 #include "catch.hpp"
+#include <chrono>
+#include <queue>
+#include <random>
+#include <sstream>
 #include "Stream.h"
 #include "PriorityQueue.h"
 #include "Archiver.h"
+#include "SpscRing.h"
+#include "BufferCodec.h"
+
+#if __has_include(<sys/stat.h>)
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// Heap allocations made by the current thread; tests read it around code that must not allocate.
+thread_local size_t allocations_count = 0;
+
+}  // namespace
+
+// The replacements are kept out of line, so that the compiler does not pair an inlined free with new.
+[[gnu::noinline]] void *operator new(size_t size) {
+    ++allocations_count;
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+[[gnu::noinline]] void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
 
 TEST_CASE("PositiveReadingWriting") {
     {
@@ -36,6 +70,36 @@ TEST_CASE("PositiveReadingWriting") {
     REQUIRE(resetted_second_part == resetted_second_expected);
     REQUIRE(reader.Eof());
 
+    reader.ResetStream();
+
+    REQUIRE(reader.ReadUInt(9) == 0b011000010);
+    REQUIRE(reader.Peek(7) == 0b1100010);
+    REQUIRE(reader.BufferedBits() == 7);
+    reader.Consume(3);
+    REQUIRE(reader.ReadUInt(4) == 0b0010);
+    REQUIRE(reader.Eof());
+    REQUIRE(reader.ReadUInt(5) == 0);
+
+    std::remove("test_file.txt");
+}
+
+TEST_CASE("LongNumbersReadingWriting") {
+    const size_t big_number = 0x123456789ABCDEF0;
+    {
+        Stream writer("test_file.txt", 'w');
+        writer.WriteNumber(5, 8);
+        writer.WriteNumber(big_number, 64);
+        writer.WriteNumber(big_number >> 24, 40);
+    }
+
+    Stream reader("test_file.txt", 'r', true);
+    REQUIRE(reader.ReadUInt(8) == 5);
+    REQUIRE(reader.ReadUInt(64) == big_number);
+    std::vector<bool> bits(40);
+    reader.ReadBits(40, bits);
+    REQUIRE(decompressor::ToNum(bits) == (big_number >> 24));
+    REQUIRE(reader.Eof());
+
     std::remove("test_file.txt");
 }
 
@@ -114,6 +178,95 @@ TEST_CASE("QueueTest") {
     REQUIRE(errors == 2);
 }
 
+TEST_CASE("QueueOperationsTest") {
+    PriorityQueue<std::unique_ptr<size_t>, bool (*)(const std::unique_ptr<size_t> &, const std::unique_ptr<size_t> &)>
+        pointers([](const std::unique_ptr<size_t> &a, const std::unique_ptr<size_t> &b) { return *a > *b; });
+    pointers.Reserve(3);
+    pointers.Push(std::make_unique<size_t>(1));
+    pointers.Emplace(new size_t(3));
+    pointers.Push(std::make_unique<size_t>(2));
+    REQUIRE(*pointers.PopTop() == 3);
+    REQUIRE(*pointers.PopTop() == 2);
+    REQUIRE(*pointers.Top() == 1);
+    REQUIRE(pointers.Size() == 1);
+
+    std::mt19937 generator(7);
+    std::vector<uint32_t> values(1000);
+    for (uint32_t &value : values) {
+        value = generator() % 100;
+    }
+    std::vector<uint32_t> expected = values;
+    std::sort(expected.begin(), expected.end());
+
+    PriorityQueue<uint32_t, std::less<uint32_t>, 4> heapified;
+    heapified.Push(values[0]);
+    heapified.Heapify(values.begin() + 1, values.end());
+    PriorityQueue<uint32_t> pushed;
+    for (uint32_t value : values) {
+        pushed.Push(value);
+    }
+    std::vector<uint32_t> from_heapified;
+    std::vector<uint32_t> from_pushed;
+    while (!heapified.Empty()) {
+        from_heapified.push_back(heapified.PopTop());
+        from_pushed.push_back(pushed.PopTop());
+    }
+    REQUIRE(from_heapified == expected);
+    REQUIRE(from_pushed == expected);
+
+    PriorityQueue<uint32_t, std::less<uint32_t>, 4, FixedVector<uint32_t, 1000>> fixed;
+    fixed.Heapify(values.begin(), values.end());
+    std::vector<uint32_t> from_fixed;
+    while (!fixed.Empty()) {
+        from_fixed.push_back(fixed.PopTop());
+    }
+    REQUIRE(from_fixed == expected);
+    fixed.Heapify(values.begin(), values.end());
+    bool overflow_error = false;
+    try {
+        fixed.Push(0);
+    } catch (const std::runtime_error &) {
+        overflow_error = true;
+    }
+    REQUIRE(overflow_error);
+}
+
+TEST_CASE("QueueBenchmark", "[.benchmark]") {
+    std::mt19937_64 generator(42);
+    std::vector<uint64_t> values(1 << 20);
+    for (uint64_t &value : values) {
+        value = generator();
+    }
+
+    auto measure = [&values](std::string_view name, auto queue) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t checksum = 0;
+        if constexpr (requires { queue.PopTop(); }) {
+            queue.Reserve(values.size());
+            for (uint64_t value : values) {
+                queue.Push(value);
+            }
+            while (!queue.Empty()) {
+                checksum += queue.PopTop();
+            }
+        } else {
+            for (uint64_t value : values) {
+                queue.push(value);
+            }
+            while (!queue.empty()) {
+                checksum += queue.top();
+                queue.pop();
+            }
+        }
+        double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << "\t" << elapsed / values.size() << " ns/element\t" << checksum << "\n";
+    };
+
+    measure("std::priority_queue", std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>>());
+    measure("PriorityQueue<2>", PriorityQueue<uint64_t, std::less<uint64_t>, 2>());
+    measure("PriorityQueue<4>", PriorityQueue<uint64_t, std::less<uint64_t>, 4>());
+}
+
 TEST_CASE("KanonicTest") {
     std::unordered_map<size_t, size_t> counts;
     counts[0] = 15;
@@ -138,6 +291,21 @@ TEST_CASE("KanonicTest") {
     REQUIRE(kanonic_order == expected_order);
 }
 
+TEST_CASE("TreeAllocationTest") {
+    std::mt19937 generator(13);
+    HaffmanTree::Frequencies counts{};
+    for (size_t &count : counts) {
+        count = generator() % 1000;
+    }
+    HaffmanTree tree(counts);
+    for (size_t i = 0; i < 10; ++i) {
+        counts[i * 7] += generator() % 100000;
+        size_t allocations_before = allocations_count;
+        tree.Build(counts, HaffmanTree::DEFAULT_MAX_CODE_LENGTH);
+        REQUIRE(allocations_count == allocations_before);
+    }
+}
+
 TEST_CASE("BadDecompressedTest") {
     {
         Stream writer("bad_decompressed.arc", 'w');
@@ -205,3 +373,997 @@ TEST_CASE("DecompressTest") {
         REQUIRE(expected == cur);
     }
 }
+
+TEST_CASE("DecoderTest") {
+    std::unordered_map<size_t, size_t> counts;
+    size_t prev = 1;
+    size_t cur = 1;
+    for (size_t i = 0; i < 16; ++i) {
+        counts[i] = cur;
+        size_t next = prev + cur;
+        prev = cur;
+        cur = next;
+    }
+
+    HaffmanTree tree(counts);
+    std::unordered_map<size_t, std::vector<bool>> kanonic_codes = tree.GetKanonicCodes();
+    std::vector<size_t> message = {15, 0, 1, 14, 7, 0, 3, 15, 1};
+    {
+        Stream writer("decoder_test.arc", 'w');
+        for (size_t symbol : message) {
+            writer.Write(kanonic_codes[symbol]);
+        }
+    }
+
+    HaffmanDecoder decoder = HaffmanTree::RestoreKanonicCodes(tree.GetHaffmanCodes());
+    Stream reader("decoder_test.arc", 'r', true);
+    std::vector<size_t> decoded;
+    for (size_t i = 0; i < message.size(); ++i) {
+        std::optional<size_t> symbol = decoder.Decode(reader);
+        REQUIRE(symbol.has_value());
+        decoded.push_back(symbol.value());
+    }
+    REQUIRE(decoded == message);
+    REQUIRE(kanonic_codes[0].size() > HaffmanDecoder::LOOKUP_BITS);
+    std::remove("decoder_test.arc");
+}
+
+TEST_CASE("BitWriterTest") {
+    {
+        Stream writer("bits_writer.txt", 'w');
+        writer.WriteBits(0b101, 3);
+        writer.WriteNumber(300, 9);
+        writer.WriteBits(0xDEADBEEFCAFEULL, 48);
+        writer.Write({true, false, true, true});
+    }
+    {
+        Stream writer("vector_writer.txt", 'w');
+        writer.Write({true, false, true});
+        writer.Write({true, false, false, true, false, true, true, false, false});
+        std::vector<bool> long_code;
+        for (size_t i = 0; i < 48; ++i) {
+            long_code.push_back((0xDEADBEEFCAFEULL >> (47 - i)) & 1);
+        }
+        writer.Write(long_code);
+        writer.Write({true, false, true, true});
+    }
+
+    Stream bits_reader("bits_writer.txt", 'r');
+    Stream vector_reader("vector_writer.txt", 'r');
+    std::vector<unsigned char> bits_bytes;
+    std::vector<unsigned char> vector_bytes;
+    while (!bits_reader.Eof()) {
+        bits_bytes.push_back(bits_reader.ReadChar());
+    }
+    while (!vector_reader.Eof()) {
+        vector_bytes.push_back(vector_reader.ReadChar());
+    }
+    REQUIRE(bits_bytes.size() == 8);
+    REQUIRE(bits_bytes == vector_bytes);
+    REQUIRE(bits_bytes[0] == 0b10110010);
+    REQUIRE(bits_bytes[7] == 0b11101011);
+
+    std::remove("bits_writer.txt");
+    std::remove("vector_writer.txt");
+}
+
+TEST_CASE("ParallelCompressTest") {
+    std::vector<std::string> names = {"parallel_a.txt", "parallel_b.txt", "parallel_c.txt", "parallel_d.txt"};
+    for (size_t i = 0; i < names.size(); ++i) {
+        Stream writer(names[i], 'w');
+        for (size_t j = 0; j < 1000 * i + 7; ++j) {
+            writer.WriteByte(static_cast<char>('a' + (j * j + i) % (5 + 7 * i)));
+        }
+    }
+    std::vector<std::string_view> filenames(names.begin(), names.end());
+
+    compressor::Compress(filenames, "serial_archive.arc");
+    compressor::Compress(filenames, "parallel_archive.arc", {.threads = 3});
+
+    Stream serial_reader("serial_archive.arc", 'r');
+    Stream parallel_reader("parallel_archive.arc", 'r');
+    std::vector<unsigned char> serial_bytes;
+    std::vector<unsigned char> parallel_bytes;
+    while (!serial_reader.Eof()) {
+        serial_bytes.push_back(serial_reader.ReadChar());
+    }
+    while (!parallel_reader.Eof()) {
+        parallel_bytes.push_back(parallel_reader.ReadChar());
+    }
+    REQUIRE(!serial_bytes.empty());
+    REQUIRE(serial_bytes == parallel_bytes);
+
+    for (const std::string &name : names) {
+        std::remove(name.c_str());
+    }
+    std::remove("serial_archive.arc");
+    std::remove("parallel_archive.arc");
+}
+
+TEST_CASE("BlockCompressTest") {
+    std::vector<char> expected;
+    for (size_t i = 0; i < 5000; ++i) {
+        expected.push_back(static_cast<char>(i % 7 == 0 ? 'x' : 'a' + i % 3));
+    }
+    {
+        Stream writer("block_file.txt", 'w');
+        writer.WriteBytes(expected.data(), expected.size());
+    }
+
+    for (size_t threads : {1, 3}) {
+        compressor::Compress({"block_file.txt"}, "block_archive.arc", {.threads = threads, .block_size = 1000});
+        std::remove("block_file.txt");
+        decompressor::Decompress("block_archive.arc", {.threads = threads});
+
+        Stream reader("block_file.txt", 'r');
+        std::vector<char> restored(expected.size() + 1);
+        restored.resize(reader.ReadBytes(restored.data(), restored.size()));
+        REQUIRE(restored == expected);
+    }
+
+    {
+        Stream writer("block_archive.arc", 'w');
+        writer.WriteNumber(0, 16);
+        writer.WriteNumber(FORMAT_MAGIC, 16);
+        writer.WriteNumber(BLOCK_FORMAT_VERSION, 8);
+        writer.WriteNumber(1000, 32);
+        writer.WriteNumber(MEMBER_TAG, 8);
+        writer.WriteNumber(1, 16);
+        writer.WriteByte('z');
+        writer.WriteNumber(BLOCK_HAFFMAN, 8);
+        writer.WriteNumber(100, 32);
+        writer.WriteNumber(50, 32);
+    }
+    bool error = false;
+    try {
+        decompressor::Decompress("block_archive.arc");
+    } catch (const std::runtime_error &) {
+        error = true;
+    }
+    REQUIRE(error);
+
+    std::remove("z");
+    std::remove("block_file.txt");
+    std::remove("block_archive.arc");
+}
+
+TEST_CASE("ArchiveIndexTest") {
+    std::vector<std::string> names = {"index_a.txt", "index_b.txt", "index_c.txt"};
+    for (size_t i = 0; i < names.size(); ++i) {
+        Stream writer(names[i], 'w');
+        for (size_t j = 0; j < 300 * (i + 1); ++j) {
+            writer.WriteByte(static_cast<char>('a' + (i + j) % 4));
+        }
+    }
+    std::vector<std::string_view> filenames(names.begin(), names.end());
+    compressor::Compress(filenames, "index_archive.arc", {.block_size = 256});
+
+    std::vector<MemberInfo> members = decompressor::List("index_archive.arc");
+    REQUIRE(members.size() == 3);
+    for (size_t i = 0; i < members.size(); ++i) {
+        REQUIRE(members[i].name == names[i]);
+        REQUIRE(members[i].original_size == 300 * (i + 1));
+        REQUIRE(members[i].compressed_size > 0);
+    }
+
+    compressor::Compress(filenames, "index_legacy.arc");
+    std::vector<MemberInfo> legacy_members = decompressor::List("index_legacy.arc");
+    REQUIRE(legacy_members.size() == 3);
+    size_t legacy_compressed_size = 0;
+    for (size_t i = 0; i < legacy_members.size(); ++i) {
+        REQUIRE(legacy_members[i].name == names[i]);
+        REQUIRE(legacy_members[i].original_size == 300 * (i + 1));
+        REQUIRE(legacy_members[i].compressed_size > 0);
+        legacy_compressed_size += legacy_members[i].compressed_size;
+    }
+    size_t legacy_archive_size = std::filesystem::file_size("index_legacy.arc");
+    REQUIRE(legacy_compressed_size >= legacy_archive_size);
+    REQUIRE(legacy_compressed_size <= legacy_archive_size + legacy_members.size());
+    REQUIRE(decompressor::HasIndex("index_archive.arc"));
+    REQUIRE(!decompressor::HasIndex("index_legacy.arc"));
+    REQUIRE(!decompressor::HasIndex(Stream::STANDARD_STREAM_NAME));
+    std::remove("index_legacy.arc");
+
+    for (const std::string &name : names) {
+        std::remove(name.c_str());
+    }
+    decompressor::Extract("index_archive.arc", {.members = {"index_b.txt"}});
+    {
+        Stream reader("index_b.txt", 'r');
+        REQUIRE(reader.Size() == 600);
+    }
+    bool error = false;
+    try {
+        Stream missing_reader("index_a.txt", 'r');
+    } catch (const std::runtime_error &) {
+        error = true;
+    }
+    REQUIRE(error);
+
+    error = false;
+    try {
+        decompressor::Extract("index_archive.arc", {.members = {"index_d.txt"}});
+    } catch (const std::runtime_error &) {
+        error = true;
+    }
+    REQUIRE(error);
+
+    std::remove("index_b.txt");
+    std::remove("index_archive.arc");
+}
+
+TEST_CASE("MappedReaderTest") {
+    std::string expected = "mapped reader contents";
+    {
+        Stream writer("mapped_file.txt", 'w');
+        writer.WriteBytes(expected.data(), expected.size());
+    }
+
+    Stream reader("mapped_file.txt", 'r');
+    std::optional<std::span<const char>> contiguous_data = reader.GetContiguousData();
+    REQUIRE(contiguous_data.has_value());
+    REQUIRE(std::string(contiguous_data->begin(), contiguous_data->end()) == expected);
+    REQUIRE(reader.Size() == expected.size());
+
+    reader.Seek(7);
+    std::string tail(expected.size() - 7, '\0');
+    REQUIRE(reader.ReadBytes(tail.data(), tail.size()) == tail.size());
+    REQUIRE(tail == expected.substr(7));
+    REQUIRE(reader.Eof());
+
+    Stream writer("mapped_file.txt", 'w');
+    REQUIRE(!writer.GetContiguousData().has_value());
+    std::remove("mapped_file.txt");
+}
+
+TEST_CASE("StreamingCompressTest") {
+    {
+        Stream writer("regular_file.txt", 'w');
+        writer.WriteByte('r');
+    }
+    REQUIRE(!compressor::NeedsStreaming({"regular_file.txt"}));
+    REQUIRE(compressor::NeedsStreaming({"regular_file.txt", "/dev/null"}));
+    REQUIRE(compressor::NeedsStreaming({"-"}));
+    REQUIRE(GetFilename("-") == STDIN_MEMBER_NAME);
+
+    compressor::Compress({"regular_file.txt", "/dev/null"}, "streaming_archive.arc");
+    std::vector<MemberInfo> members = decompressor::List("streaming_archive.arc");
+    REQUIRE(members.size() == 2);
+    REQUIRE(members[0].name == "regular_file.txt");
+    REQUIRE(members[0].original_size == 1);
+    REQUIRE(members[1].name == "null");
+    REQUIRE(members[1].original_size == 0);
+
+    std::remove("regular_file.txt");
+    std::remove("streaming_archive.arc");
+}
+
+TEST_CASE("AdaptiveCompressTest") {
+    std::vector<char> expected;
+    for (size_t i = 0; i < 20000; ++i) {
+        expected.push_back(static_cast<char>(i < 10000 ? 'a' + i % 5 : (i * 31) % 256));
+    }
+    {
+        std::vector<char> encoded;
+        {
+            Stream writer(encoded);
+            AdaptiveHaffman model;
+            for (char c : expected) {
+                model.Encode(static_cast<unsigned char>(c), writer);
+            }
+            model.Encode(AdaptiveHaffman::END_SYMBOL, writer);
+        }
+        REQUIRE(encoded.size() < expected.size());
+
+        Stream reader(std::as_bytes(std::span<const char>(encoded)));
+        AdaptiveHaffman model;
+        std::vector<char> restored;
+        for (std::optional<size_t> symbol = model.Decode(reader);
+             symbol.has_value() && symbol.value() != AdaptiveHaffman::END_SYMBOL; symbol = model.Decode(reader)) {
+            restored.push_back(static_cast<char>(symbol.value()));
+        }
+        REQUIRE(restored == expected);
+    }
+
+    {
+        Stream writer("adaptive_file.txt", 'w');
+        writer.WriteBytes(expected.data(), expected.size());
+    }
+    compressor::Compress({"adaptive_file.txt", "/dev/null"}, "adaptive_archive.arc", {.adaptive = true});
+    std::remove("adaptive_file.txt");
+    std::vector<MemberInfo> members = decompressor::List("adaptive_archive.arc");
+    REQUIRE(members.size() == 2);
+    REQUIRE(members[0].original_size == expected.size());
+    REQUIRE(members[1].original_size == 0);
+
+    decompressor::Decompress("adaptive_archive.arc");
+    Stream reader("adaptive_file.txt", 'r');
+    std::vector<char> restored(expected.size() + 1);
+    restored.resize(reader.ReadBytes(restored.data(), restored.size()));
+    REQUIRE(restored == expected);
+
+    std::remove("null");
+    std::remove("adaptive_file.txt");
+    std::remove("adaptive_archive.arc");
+}
+
+TEST_CASE("HistogramTest") {
+    std::vector<char> data(Histogram::PARALLEL_THRESHOLD + 3);
+    std::unordered_map<size_t, size_t> expected;
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>((i * i + i / 7) % 251);
+        ++expected[static_cast<unsigned char>(data[i])];
+    }
+    expected[FILENAME_END] = 2;
+
+    HaffmanTree::Frequencies expected_counts = HaffmanTree::ToFrequencies(expected);
+    ThreadPool pool(3);
+    for (ThreadPool *current_pool : {static_cast<ThreadPool *>(nullptr), &pool}) {
+        Histogram histogram;
+        histogram.Add(data, current_pool);
+        histogram.Add(FILENAME_END, 2);
+        REQUIRE(histogram.GetCounts() == expected_counts);
+    }
+
+    Histogram histogram;
+    histogram.Add(std::span<const char>(data).first(5));
+    histogram.Merge(histogram);
+    REQUIRE(histogram.GetCounts()[static_cast<unsigned char>(data[0])] == 2);
+
+    HaffmanTree map_tree(expected);
+    HaffmanTree array_tree(expected_counts);
+    REQUIRE(map_tree.GetHaffmanCodes() == array_tree.GetHaffmanCodes());
+}
+
+TEST_CASE("LengthLimitTest") {
+    HaffmanTree::Frequencies counts{};
+    size_t previous = 1;
+    size_t current = 1;
+    for (size_t char_num = 0; char_num < 40; ++char_num) {
+        counts[char_num] = current;
+        current += previous;
+        previous = current - previous;
+    }
+
+    REQUIRE(HaffmanTree(counts, HaffmanDecoder::MAX_CODE_LENGTH).GetHaffmanCodes().back().second == 39);
+    for (size_t max_code_length : {11, 15}) {
+        HaffmanTree tree(counts, max_code_length);
+        std::vector<std::pair<size_t, size_t>> &codes = tree.GetHaffmanCodes();
+        REQUIRE(codes.size() == 40);
+        REQUIRE(codes.back().second == max_code_length);
+        uint64_t kraft_sum = 0;
+        for (auto &[char_num, length] : codes) {
+            kraft_sum += uint64_t{1} << (max_code_length - length);
+        }
+        REQUIRE(kraft_sum == uint64_t{1} << max_code_length);
+        REQUIRE(codes.front().first == 39);
+        REQUIRE_NOTHROW(HaffmanTree::RestoreKanonicCodes(codes));
+    }
+
+    bool error = false;
+    try {
+        HaffmanTree tree(counts, HaffmanTree::MIN_CODE_LENGTH_LIMIT - 1);
+    } catch (const std::runtime_error &) {
+        error = true;
+    }
+    REQUIRE(error);
+}
+
+TEST_CASE("InterleavedBlockTest") {
+    std::vector<char> block;
+    for (size_t i = 0; i < 3 * MIN_INTERLEAVED_BLOCK_SIZE + 2; ++i) {
+        block.push_back(static_cast<char>(i % 11 == 0 ? i % 256 : 'a' + i % 5));
+    }
+    auto wrong_format_error = std::runtime_error("wrong format");
+    for (size_t size : {MIN_INTERLEAVED_BLOCK_SIZE - 1, MIN_INTERLEAVED_BLOCK_SIZE + 1, block.size()}) {
+        std::span<const char> data = std::span<const char>(block).first(size);
+        std::vector<char> encoded = compressor::EncodeBlock(data);
+        size_t block_type = static_cast<unsigned char>(encoded[0]);
+        REQUIRE(block_type == (size < MIN_INTERLEAVED_BLOCK_SIZE ? BLOCK_HAFFMAN : BLOCK_HAFFMAN_INTERLEAVED));
+
+        std::span<const char> payload = std::span<const char>(encoded).subspan(9);
+        std::vector<char> decoded = decompressor::DecodeBlock(block_type, payload, size, wrong_format_error);
+        REQUIRE(std::equal(decoded.begin(), decoded.end(), data.begin(), data.end()));
+
+        bool error = false;
+        try {
+            decompressor::DecodeBlock(block_type, payload.first(payload.size() - 16), size, wrong_format_error);
+        } catch (const std::runtime_error &) {
+            error = true;
+        }
+        REQUIRE(error);
+    }
+}
+
+TEST_CASE("CompressStatsTest") {
+    {
+        Stream writer("stats_file.txt", 'w');
+        for (size_t i = 0; i < 10000; ++i) {
+            writer.WriteByte("aaaabbc"[i % 7]);
+        }
+    }
+    for (size_t block_size : {size_t{0}, size_t{4096}}) {
+        CompressStats stats =
+            compressor::Compress({"stats_file.txt", "/dev/null"}, "stats_archive.arc", {.block_size = block_size});
+        REQUIRE(stats.GetMembers().size() == 2);
+        const MemberStats &member = stats.GetMembers()[0];
+        REQUIRE(member.name == "stats_file.txt");
+        REQUIRE(member.bytes_in == 10000);
+        REQUIRE(member.entropy_symbols == 10000);
+        REQUIRE(member.table_bits > 0);
+        REQUIRE(member.entropy_bits <= member.bits_out);
+        REQUIRE(stats.GetTotal().bytes_in == 10000);
+
+        std::stringstream json;
+        stats.Print(json, true);
+        REQUIRE(json.str().find("\"total\": {\"name\": \"total\", \"bytes_in\": 10000") != std::string::npos);
+    }
+
+    std::remove("stats_file.txt");
+    std::remove("stats_archive.arc");
+}
+
+TEST_CASE("StoredBlockTest") {
+    std::mt19937 generator(18);
+    std::vector<char> block(3 * MIN_INTERLEAVED_BLOCK_SIZE);
+    for (char &c : block) {
+        c = static_cast<char>(generator() % 256);
+    }
+    MemberStats stats;
+    std::vector<char> encoded = compressor::EncodeBlock(block, {}, &stats);
+    REQUIRE(static_cast<unsigned char>(encoded[0]) == BLOCK_STORED);
+    REQUIRE(encoded.size() == block.size() + 9);
+    REQUIRE(stats.table_bits == 0);
+
+    auto wrong_format_error = std::runtime_error("wrong format");
+    std::span<const char> payload = std::span<const char>(encoded).subspan(9);
+    REQUIRE(decompressor::DecodeBlock(BLOCK_STORED, payload, block.size(), wrong_format_error) == block);
+    bool error = false;
+    try {
+        decompressor::DecodeBlock(BLOCK_STORED, payload.first(payload.size() - 1), block.size(), wrong_format_error);
+    } catch (const std::runtime_error &) {
+        error = true;
+    }
+    REQUIRE(error);
+
+    {
+        Stream writer("stored_file.bin", 'w');
+        writer.WriteBytes(block.data(), block.size());
+        for (size_t i = 0; i < block.size(); ++i) {
+            writer.WriteByte('a' + i % 3);
+        }
+    }
+    compressor::Compress({"stored_file.bin"}, "stored_archive.arc", {.block_size = block.size()});
+    std::remove("stored_file.bin");
+    std::vector<MemberInfo> members = decompressor::List("stored_archive.arc");
+    REQUIRE(members.size() == 1);
+    REQUIRE(members[0].compressed_size < 2 * block.size());
+
+    decompressor::Decompress("stored_archive.arc");
+    Stream reader("stored_file.bin", 'r');
+    std::vector<char> restored(2 * block.size() + 1);
+    restored.resize(reader.ReadBytes(restored.data(), restored.size()));
+    REQUIRE(restored.size() == 2 * block.size());
+    REQUIRE(std::equal(block.begin(), block.end(), restored.begin()));
+    REQUIRE(restored.back() == static_cast<char>('a' + (block.size() - 1) % 3));
+
+    std::remove("stored_file.bin");
+    std::remove("stored_archive.arc");
+}
+
+TEST_CASE("SolidCompressTest") {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 6; ++i) {
+        names.push_back("solid_file_" + std::to_string(i) + ".txt");
+        Stream writer(names.back(), 'w');
+        for (size_t j = 0; j < (i == 3 ? 5000 : 100 * i); ++j) {
+            writer.WriteByte(static_cast<char>('a' + (i + j) % 7));
+        }
+    }
+    std::vector<std::string_view> filenames(names.begin(), names.end());
+    CompressStats stats = compressor::Compress(filenames, "solid_archive.arc", {.block_size = 256, .solid_size = 1000});
+    REQUIRE(stats.GetMembers().size() == 3);
+
+    std::vector<MemberInfo> members = decompressor::List("solid_archive.arc");
+    REQUIRE(members.size() == names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        REQUIRE(members[i].name == names[i]);
+        REQUIRE(members[i].original_size == (i == 3 ? 5000 : 100 * i));
+    }
+    REQUIRE(members[0].offset == members[2].offset);
+    REQUIRE(members[2].offset != members[3].offset);
+    REQUIRE(members[4].offset == members[5].offset);
+
+    std::vector<std::vector<char>> expected;
+    for (const std::string &name : names) {
+        Stream reader(name, 'r');
+        expected.emplace_back(reader.Size());
+        reader.ReadBytes(expected.back().data(), expected.back().size());
+        std::remove(name.c_str());
+    }
+    auto check_file = [&expected, &names](size_t i) {
+        Stream reader(names[i], 'r');
+        std::vector<char> restored(expected[i].size() + 1);
+        restored.resize(reader.ReadBytes(restored.data(), restored.size()));
+        REQUIRE(restored == expected[i]);
+    };
+
+    decompressor::Extract("solid_archive.arc", {.members = {names[1], names[5]}});
+    check_file(1);
+    check_file(5);
+    REQUIRE(!std::ifstream(names[2]).is_open());
+
+    decompressor::Decompress("solid_archive.arc", {.threads = 2});
+    for (size_t i = 0; i < names.size(); ++i) {
+        check_file(i);
+        std::remove(names[i].c_str());
+    }
+    std::remove("solid_archive.arc");
+}
+
+TEST_CASE("DirectoryCompressTest") {
+    std::filesystem::create_directories("walk_dir/sub/deeper");
+    std::filesystem::create_directories("walk_dir/empty");
+    std::vector<std::string> names = {"walk_dir/b.txt", "walk_dir/a.txt", "walk_dir/sub/deeper/c.txt",
+                                      "walk_dir/sub/d.txt"};
+    for (const std::string &name : names) {
+        Stream writer(name, 'w');
+        writer.WriteBytes(name.data(), name.size());
+    }
+
+    {
+        FileWalker walker({"walk_dir/sub/", "walk_dir/b.txt"}, {"walk_dir/sub/d.txt"}, 1);
+        REQUIRE(walker.Next()->name == "sub/deeper/c.txt");
+        std::optional<InputFile> file = walker.Next();
+        REQUIRE(file->path == "walk_dir/b.txt");
+        REQUIRE(file->name == "b.txt");
+        REQUIRE(!walker.Next().has_value());
+    }
+
+    compressor::Compress({"walk_dir"}, "walk_dir/walk_archive.arc");
+    std::filesystem::rename("walk_dir/walk_archive.arc", "walk_archive.arc");
+    std::vector<MemberInfo> members = decompressor::List("walk_archive.arc");
+    std::sort(names.begin(), names.end());
+    REQUIRE(members.size() == names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        REQUIRE(members[i].name == names[i]);
+    }
+
+    std::filesystem::remove_all("walk_dir");
+    decompressor::Decompress("walk_archive.arc");
+    for (const std::string &name : names) {
+        Stream reader(name, 'r');
+        std::string restored(name.size() + 1, '\0');
+        restored.resize(reader.ReadBytes(restored.data(), restored.size()));
+        REQUIRE(restored == name);
+    }
+
+    for (const char *name : {"../escape.txt", "/tmp/escape.txt", "walk_dir/../../escape.txt", ""}) {
+        bool error = false;
+        try {
+            decompressor::PrepareMemberPath(name);
+        } catch (const std::runtime_error &) {
+            error = true;
+        }
+        REQUIRE(error);
+    }
+
+    std::filesystem::remove_all("walk_dir");
+    std::remove("walk_archive.arc");
+}
+
+TEST_CASE("PipelineTest") {
+    SpscRing<std::unique_ptr<size_t>, 4> ring;
+    const size_t count = 100000;
+    std::thread producer([&ring] {
+        for (size_t i = 0; i < count; ++i) {
+            ring.Push(std::make_unique<size_t>(i));
+        }
+    });
+    bool is_ordered = true;
+    for (size_t i = 0; i < count; ++i) {
+        is_ordered = is_ordered && *ring.Pop() == i;
+    }
+    producer.join();
+    REQUIRE(is_ordered);
+    REQUIRE(!ring.TryPop().has_value());
+
+    std::vector<char> expected;
+    {
+        Stream writer("pipeline_file.bin", 'w');
+        for (size_t i = 0; expected.size() < 3 * Stream::PIPELINE_BUFFER_SIZE + 5; ++i) {
+            if (i % 3 == 0) {
+                writer.WriteByte(static_cast<char>(i));
+                expected.push_back(static_cast<char>(i));
+            } else {
+                writer.WriteNumber(i & 0xFFFF, 16);
+                expected.push_back(static_cast<char>((i & 0xFFFF) >> 8));
+                expected.push_back(static_cast<char>(i));
+            }
+        }
+    }
+    std::vector<char> restored(expected.size() + 1);
+    {
+        Stream reader("pipeline_file.bin", 'r');
+        restored.resize(reader.ReadBytes(restored.data(), restored.size()));
+    }
+    REQUIRE(restored == expected);
+    std::remove("pipeline_file.bin");
+
+#if __has_include(<sys/stat.h>)
+    REQUIRE(mkfifo("pipeline_fifo", 0600) == 0);
+    std::thread fifo_writer([&expected] {
+        std::ofstream fifo("pipeline_fifo", std::ios::binary);
+        fifo.write(expected.data(), expected.size());
+    });
+    {
+        Stream reader("pipeline_fifo", 'r');
+        REQUIRE(!reader.IsSeekable());
+        restored.assign(expected.size() + 1, 0);
+        restored.resize(reader.ReadBytes(restored.data(), restored.size()));
+        REQUIRE(reader.Eof());
+    }
+    fifo_writer.join();
+    REQUIRE(restored == expected);
+    std::remove("pipeline_fifo");
+#endif
+}
+
+TEST_CASE("BufferCodecTest") {
+    std::mt19937 generator(22);
+    std::vector<std::byte> input;
+    for (size_t i = 0; i < 5000; ++i) {
+        input.push_back(static_cast<std::byte>('a' + generator() % 4));
+    }
+    for (size_t i = 0; i < 5000; ++i) {
+        input.push_back(static_cast<std::byte>(generator() % 256));
+    }
+
+    BufferCodec codec({.block_size = 4096});
+    std::vector<std::byte> compressed;
+    std::vector<std::byte> restored;
+    for (size_t size : {size_t{0}, size_t{1}, size_t{4096}, input.size()}) {
+        std::span<const std::byte> data = std::span<const std::byte>(input).first(size);
+        size_t compressed_size = codec.Compress(data, compressed);
+        REQUIRE(compressed_size == compressed.size());
+        REQUIRE(compressed_size <= BufferCodec::MaxCompressedSize(size, 4096));
+        REQUIRE(BufferCodec::GetDecompressedSize(compressed) == size);
+        REQUIRE(codec.Decompress(compressed, restored) == size);
+        REQUIRE(std::equal(restored.begin(), restored.end(), data.begin(), data.end()));
+    }
+    REQUIRE(compressed.size() < input.size());
+
+    std::vector<std::byte> fixed_output(BufferCodec::MaxCompressedSize(input.size(), 4096));
+    size_t compressed_size = codec.Compress(input, fixed_output);
+    REQUIRE(std::equal(compressed.begin(), compressed.end(), fixed_output.begin(),
+                       fixed_output.begin() + compressed_size));
+    std::vector<std::byte> fixed_restored(input.size());
+    REQUIRE(codec.Decompress(std::span<const std::byte>(fixed_output).first(compressed_size),
+                             std::span<std::byte>(fixed_restored)) == input.size());
+    REQUIRE(fixed_restored == input);
+
+    auto throws = [](auto &&body) {
+        try {
+            body();
+        } catch (const std::runtime_error &) {
+            return true;
+        }
+        return false;
+    };
+    REQUIRE(throws([&] { codec.Compress(input, std::span<std::byte>(fixed_output).first(100)); }));
+    REQUIRE(throws([&] { codec.Compress(input, std::span<std::byte>(fixed_output).first(fixed_output.size() - 1)); }));
+    std::array<std::byte, 3> small_output;
+    REQUIRE(throws([&] {
+        Stream writer{std::span<std::byte>(small_output)};
+        writer.WriteNumber(0, 32);
+    }));
+    REQUIRE(throws([&] { codec.Decompress(compressed, std::span<std::byte>(fixed_restored).first(100)); }));
+    REQUIRE(throws([&] { codec.Decompress(std::span<const std::byte>(compressed).first(50), restored); }));
+    REQUIRE(throws([] { BufferCodec({.adaptive = true}); }));
+
+    // A reused codec keeps all of its scratch storage: after the first call, compressing and decompressing
+    // into caller buffers does not allocate.
+    std::vector<std::byte> large_input;
+    for (size_t i = 0; i < 300000; ++i) {
+        large_input.push_back(static_cast<std::byte>(i % 7 == 0 ? generator() % 256 : 'a' + generator() % 8));
+    }
+    BufferCodec reused_codec({.block_size = 1 << 16});
+    std::vector<std::byte> large_compressed(BufferCodec::MaxCompressedSize(large_input.size(), 1 << 16));
+    std::vector<std::byte> large_restored(large_input.size());
+    for (size_t i = 0; i < 3; ++i) {
+        size_t allocations_before = allocations_count;
+        size_t large_compressed_size = reused_codec.Compress(large_input, std::span<std::byte>(large_compressed));
+        reused_codec.Decompress(std::span<const std::byte>(large_compressed).first(large_compressed_size),
+                                std::span<std::byte>(large_restored));
+        REQUIRE((i == 0 || allocations_count == allocations_before));
+    }
+    REQUIRE(large_restored == large_input);
+
+    // A frame of a few hundred bytes that declares blocks of MAX_BLOCK_SIZE bytes must be rejected before
+    // the output is resized for them.
+    auto write_crafted_blocks = [](Stream &writer, size_t block_type, size_t payload_size) {
+        for (size_t i = 0; i < 20; ++i) {
+            writer.WriteNumber(block_type, 8);
+            writer.WriteNumber(MAX_BLOCK_SIZE, 32);
+            writer.WriteNumber(payload_size, 32);
+            for (size_t j = 0; j < payload_size; ++j) {
+                writer.WriteNumber(0, 8);
+            }
+        }
+        writer.WriteNumber(BLOCK_END, 8);
+        writer.WriteNumber(0, 32);
+    };
+    for (size_t block_type : {BLOCK_HAFFMAN, BLOCK_HAFFMAN_INTERLEAVED, BLOCK_STORED}) {
+        std::vector<char> crafted;
+        {
+            Stream writer(crafted);
+            writer.WriteNumber(0, 16);
+            writer.WriteNumber(FORMAT_MAGIC, 16);
+            writer.WriteNumber(BLOCK_FORMAT_VERSION, 8);
+            writer.WriteNumber(MAX_BLOCK_SIZE, 32);
+            write_crafted_blocks(writer, block_type, 1);
+        }
+        std::span<const std::byte> crafted_frame = std::as_bytes(std::span<const char>(crafted));
+        REQUIRE(throws([&] { BufferCodec::GetDecompressedSize(crafted_frame); }));
+        std::vector<std::byte> crafted_output;
+        size_t allocations_before = allocations_count;
+        REQUIRE(throws([&] { codec.Decompress(crafted_frame, crafted_output); }));
+        REQUIRE(allocations_count == allocations_before);
+        REQUIRE(crafted_output.empty());
+
+        {
+            Stream writer("crafted.arc", 'w');
+            writer.WriteNumber(0, 16);
+            writer.WriteNumber(FORMAT_MAGIC, 16);
+            writer.WriteNumber(BLOCK_FORMAT_VERSION, 8);
+            writer.WriteNumber(MAX_BLOCK_SIZE, 32);
+            writer.WriteNumber(MEMBER_TAG, 8);
+            writer.WriteNumber(1, 16);
+            writer.WriteNumber('c', 8);
+            write_crafted_blocks(writer, block_type, 1);
+            writer.WriteNumber(ARCHIVE_END_TAG, 8);
+        }
+        REQUIRE(throws([] { decompressor::Test("crafted.arc"); }));
+    }
+    std::remove("crafted.arc");
+}
+
+TEST_CASE("ChecksumTest") {
+    std::string check = "123456789";
+    Crc32c crc;
+    crc.Update(check);
+    REQUIRE(crc.GetValue() == 0xE3069283);
+    REQUIRE(Crc32c().GetValue() == 0);
+
+    std::mt19937 generator(23);
+    std::vector<char> data;
+    for (size_t i = 0; i < 3000; ++i) {
+        data.push_back(static_cast<char>(generator() % 256));
+    }
+    Crc32c whole;
+    whole.Update(data);
+    Crc32c parts;
+    for (size_t position = 0; position < data.size(); position += 1 + position % 13) {
+        parts.Update(std::span<const char>(data).subspan(position, std::min(1 + position % 13, data.size() - position)));
+    }
+    REQUIRE(parts.GetValue() == whole.GetValue());
+
+    {
+        Stream writer("checksum_file.bin", 'w');
+        writer.WriteBytes(data.data(), data.size());
+    }
+    compressor::Compress({"checksum_file.bin"}, "checksum_archive.arc", {.block_size = 1000});
+    std::remove("checksum_file.bin");
+    for (size_t threads : {1, 3}) {
+        std::vector<MemberInfo> members = decompressor::Test("checksum_archive.arc", {.threads = threads});
+        REQUIRE(members.size() == 1);
+        REQUIRE(members[0].original_size == data.size());
+    }
+    REQUIRE(!std::ifstream("checksum_file.bin").is_open());
+
+    {
+        // Random blocks are stored, so a flipped payload byte is only caught by the checksum.
+        std::fstream archive("checksum_archive.arc", std::ios::in | std::ios::out | std::ios::binary);
+        size_t payload_offset = 9 + 3 + std::string("checksum_file.bin").size() + 9;
+        archive.seekg(payload_offset + 100);
+        char byte = static_cast<char>(archive.get() ^ 1);
+        archive.seekp(payload_offset + 100);
+        archive.put(byte);
+    }
+    std::string error;
+    try {
+        decompressor::Test("checksum_archive.arc");
+    } catch (const std::runtime_error &e) {
+        error = e.what();
+    }
+    REQUIRE(error.find("Checksum mismatch in checksum_file.bin") != std::string::npos);
+
+    // Member names and the sizes of solid group members are covered by the checksum as well.
+    auto flip_byte = [](const std::string &archive_name, size_t offset) {
+        std::fstream archive(archive_name, std::ios::in | std::ios::out | std::ios::binary);
+        archive.seekg(offset);
+        char byte = static_cast<char>(archive.get() ^ 1);
+        archive.seekp(offset);
+        archive.put(byte);
+    };
+    auto test_error = [](const std::string &archive_name) {
+        try {
+            decompressor::Test(archive_name);
+        } catch (const std::runtime_error &e) {
+            return std::string(e.what());
+        }
+        return std::string();
+    };
+    {
+        Stream writer("checksum_file.bin", 'w');
+        writer.WriteBytes(data.data(), data.size());
+    }
+    {
+        Stream writer("checksum_small.bin", 'w');
+        writer.WriteBytes(data.data(), 100);
+    }
+    compressor::Compress({"checksum_file.bin"}, "checksum_archive.arc", {.block_size = 1000});
+    flip_byte("checksum_archive.arc", 9 + 3 + 2);
+    REQUIRE(test_error("checksum_archive.arc").find("Checksum mismatch") != std::string::npos);
+
+    size_t first_name_offset = 9 + 1 + 4 + 2;
+    size_t first_size_offset = first_name_offset + std::string("checksum_small.bin").size();
+    for (size_t offset : {first_name_offset + 2, first_size_offset + 3}) {
+        compressor::Compress({"checksum_small.bin", "checksum_file.bin"}, "checksum_archive.arc",
+                             {.block_size = 1000, .solid_size = 10000});
+        REQUIRE(test_error("checksum_archive.arc").empty());
+        flip_byte("checksum_archive.arc", offset);
+        REQUIRE(test_error("checksum_archive.arc").find("Checksum mismatch") != std::string::npos);
+    }
+    std::remove("checksum_file.bin");
+    std::remove("checksum_small.bin");
+    std::remove("checksum_archive.arc");
+
+    BufferCodec codec;
+    std::vector<std::byte> compressed;
+    std::vector<std::byte> restored;
+    codec.Compress(std::as_bytes(std::span<const char>(data)), compressed);
+    std::vector<std::byte> legacy_frame(compressed.begin(), compressed.end() - BufferCodec::CHECKSUM_SIZE);
+    legacy_frame[4] = static_cast<std::byte>(MIN_BLOCK_FORMAT_VERSION);
+    REQUIRE(codec.Decompress(legacy_frame, restored) == data.size());
+    REQUIRE(std::equal(restored.begin(), restored.end(), std::as_bytes(std::span<const char>(data)).begin()));
+
+    compressed[BufferCodec::FRAME_HEADER_SIZE + BufferCodec::BLOCK_HEADER_SIZE + 7] ^= std::byte{1};
+    error.clear();
+    try {
+        codec.Decompress(compressed, restored);
+    } catch (const std::runtime_error &e) {
+        error = e.what();
+    }
+    REQUIRE(error.find("Checksum mismatch") != std::string::npos);
+}
+
+TEST_CASE("StreamingExtractTest") {
+    std::vector<std::pair<std::string, std::string>> files = {
+        {"stream_a.txt", std::string(300, 'a') + "bc"}, {"stream_empty.txt", ""}, {"stream_b.txt", "bbbb"},
+        {"stream_big.txt", std::string()}};
+    for (size_t i = 0; i < 5000; ++i) {
+        files[3].second.push_back(static_cast<char>('a' + i * i % 11));
+    }
+    std::vector<std::string_view> filenames;
+    for (const auto &[name, contents] : files) {
+        Stream writer(name, 'w');
+        writer.WriteBytes(contents.data(), contents.size());
+        filenames.push_back(name);
+    }
+    compressor::Compress(filenames, "stream_legacy.arc");
+    compressor::Compress(filenames, "stream_blocks.arc", {.block_size = 1000, .solid_size = 1024});
+    compressor::Compress(filenames, "stream_adaptive.arc", {.block_size = 1000, .adaptive = true});
+    for (const auto &[name, contents] : files) {
+        std::remove(name.c_str());
+    }
+
+    std::vector<std::pair<std::string, std::string>> extracted;
+    decompressor::DecompressOptions options{.output = [&extracted](const std::string &name) {
+        extracted.emplace_back(name, "");
+        return decompressor::MemberSink([&extracted](std::span<const char> data) {
+            extracted.back().second.append(data.begin(), data.end());
+        });
+    }};
+    for (const char *archive : {"stream_legacy.arc", "stream_blocks.arc", "stream_adaptive.arc"}) {
+        for (size_t threads : {1, 3}) {
+            extracted.clear();
+            options.threads = threads;
+            decompressor::Decompress(archive, options);
+            REQUIRE(extracted == files);
+        }
+    }
+    for (const auto &[name, contents] : files) {
+        REQUIRE(!std::ifstream(name).is_open());
+    }
+
+    extracted.clear();
+    options.threads = 1;
+    options.members = {"stream_b.txt", "stream_empty.txt"};
+    decompressor::Extract("stream_blocks.arc", options);
+    REQUIRE(extracted == std::vector<std::pair<std::string, std::string>>{files[2], files[1]});
+
+    std::remove("stream_legacy.arc");
+    std::remove("stream_blocks.arc");
+    std::remove("stream_adaptive.arc");
+}
+
+TEST_CASE("AppendTest") {
+    auto write_file = [](const std::string &name, const std::string &contents) {
+        Stream writer(name, 'w');
+        writer.WriteBytes(contents.data(), contents.size());
+    };
+    auto read_file = [](const std::string &name) {
+        std::ifstream file(name, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    };
+    std::string big(5000, '\0');
+    for (size_t i = 0; i < big.size(); ++i) {
+        big[i] = static_cast<char>('a' + i * i % 13);
+    }
+    write_file("append_a.txt", "first version");
+    write_file("append_b.txt", big);
+    std::remove("append.arc");
+    compressor::Append({"append_a.txt", "append_b.txt"}, "append.arc", {.block_size = 1000});
+    std::string old_archive = read_file("append.arc");
+    std::vector<MemberInfo> old_members = decompressor::List("append.arc");
+    REQUIRE(old_members.size() == 2);
+    size_t old_members_end = old_members.back().offset + old_members.back().compressed_size;
+
+    write_file("append_a.txt", "second version");
+    write_file("append_c.txt", "ccc");
+    compressor::Append({"append_a.txt", "append_c.txt"}, "append.arc", {.threads = 2, .solid_size = 1024});
+    REQUIRE(read_file("append.arc").compare(0, old_members_end, old_archive, 0, old_members_end) == 0);
+
+    std::vector<MemberInfo> members = decompressor::List("append.arc");
+    REQUIRE(members.size() == 4);
+    REQUIRE(members[2].name == "append_a.txt");
+    REQUIRE(members[3].name == "append_c.txt");
+    REQUIRE(decompressor::Test("append.arc").size() == 4);
+
+    std::string appended_archive = read_file("append.arc");
+    bool missing_input_error = false;
+    try {
+        compressor::Append({"append_c.txt", "append_missing.txt"}, "append.arc");
+    } catch (const std::runtime_error &) {
+        missing_input_error = true;
+    }
+    REQUIRE(missing_input_error);
+    REQUIRE(read_file("append.arc") == appended_archive);
+    for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(".")) {
+        REQUIRE(entry.path().filename().string().rfind("append.arc.append", 0) == std::string::npos);
+    }
+    {
+        TemporaryFile first("append.arc.append");
+        TemporaryFile second("append.arc.append");
+        REQUIRE(first.GetPath() != second.GetPath());
+        REQUIRE(std::filesystem::exists(first.GetPath()));
+        REQUIRE(std::filesystem::exists(second.GetPath()));
+    }
+    REQUIRE(decompressor::List("append.arc").size() == 4);
+    REQUIRE(decompressor::Test("append.arc").size() == 4);
+
+    for (const char *name : {"append_a.txt", "append_b.txt", "append_c.txt"}) {
+        std::remove(name);
+    }
+    decompressor::Extract("append.arc", {.members = {"append_a.txt"}});
+    REQUIRE(read_file("append_a.txt") == "second version");
+    std::remove("append_a.txt");
+    decompressor::Decompress("append.arc");
+    REQUIRE(read_file("append_a.txt") == "second version");
+    REQUIRE(read_file("append_b.txt") == big);
+    REQUIRE(read_file("append_c.txt") == "ccc");
+
+    compressor::Compress({"append_c.txt"}, "append_legacy.arc");
+    bool error = false;
+    try {
+        compressor::Append({"append_a.txt"}, "append_legacy.arc");
+    } catch (const std::runtime_error &) {
+        error = true;
+    }
+    REQUIRE(error);
+
+    for (const char *name : {"append_a.txt", "append_b.txt", "append_c.txt", "append.arc", "append_legacy.arc"}) {
+        std::remove(name);
+    }
+}
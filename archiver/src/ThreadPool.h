@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads_count) {
+        if (threads_count == 0) {
+            threads_count = DefaultThreadsCount();
+        }
+        for (size_t i = 0; i < threads_count; ++i) {
+            workers_.emplace_back([this] { WorkerLoop(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        has_tasks_.notify_all();
+        for (std::thread &worker : workers_) {
+            worker.join();
+        }
+    }
+
+    static size_t DefaultThreadsCount() {
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    size_t Size() const {
+        return workers_.size();
+    }
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> Submit(F &&task) {
+        auto packaged = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(task));
+        std::future<std::invoke_result_t<F>> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopped_) {
+                throw std::runtime_error("Can't submit task to stopped thread pool!");
+            }
+            tasks_.push([packaged] { (*packaged)(); });
+        }
+        has_tasks_.notify_one();
+        return result;
+    }
+
+private:
+    void WorkerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                has_tasks_.wait(lock, [this] { return stopped_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable has_tasks_;
+    bool stopped_ = false;
+};
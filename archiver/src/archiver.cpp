@@ -1,32 +1,168 @@
 #include "Archiver.h"
+#include <charconv>
+#include <limits>
+#include <thread>
+
+size_t ParseCount(std::string_view value, size_t min_value, size_t max_value) {
+    size_t result = 0;
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (value.empty() || error != std::errc() || end != value.data() + value.size() || result < min_value ||
+        result > max_value) {
+        throw std::runtime_error(std::string(INVALID_INPUT_STR));
+    }
+    return result;
+}
+
+size_t ParseSize(std::string_view value) {
+    size_t multiplier = 1;
+    if (value.ends_with('K')) {
+        multiplier = 1 << 10;
+        value.remove_suffix(1);
+    } else if (value.ends_with('M')) {
+        multiplier = 1 << 20;
+        value.remove_suffix(1);
+    }
+    return ParseCount(value, 0, std::numeric_limits<size_t>::max() / multiplier) * multiplier;
+}
+
+size_t HardwareThreads() {
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
 
 int main(int argc, char **argv) {
-    if (argc == 2 && std::string(argv[1]) == "-h") {
+    std::vector<std::string_view> args(argv + 1, argv + argc);
+    compressor::CompressOptions compress_options;
+    decompressor::DecompressOptions decompress_options;
+    bool print_stats = false;
+    bool is_json_stats = false;
+    bool is_standard_output = false;
+    try {
+        while (!args.empty() && (args[0] == "--stats" || args[0] == "--stats=json")) {
+            print_stats = true;
+            is_json_stats = args[0] == "--stats=json";
+            args.erase(args.begin());
+        }
+        while (args.size() >= 2 && (args[0] == "-j" || args[0] == "-b" || args[0] == "-m" || args[0] == "-L" ||
+                                   args[0] == "-s" || args[0] == "-o")) {
+            if (args[0] == "-j") {
+                compress_options.threads = ParseCount(args[1], 1, MAX_THREADS_PER_CORE * HardwareThreads());
+                decompress_options.threads = compress_options.threads;
+            } else if (args[0] == "-b") {
+                compress_options.block_size = ParseSize(args[1]);
+            } else if (args[0] == "-s") {
+                compress_options.solid_size = ParseSize(args[1]);
+            } else if (args[0] == "-o") {
+                if (args[1] != Stream::STANDARD_STREAM_NAME) {
+                    throw std::runtime_error(std::string(INVALID_INPUT_STR));
+                }
+                is_standard_output = true;
+            } else if (args[0] == "-L") {
+                compress_options.max_code_length =
+                    ParseCount(args[1], HaffmanTree::MIN_CODE_LENGTH_LIMIT, HaffmanDecoder::MAX_CODE_LENGTH);
+            } else if (args[1] == "adaptive" || args[1] == "static") {
+                compress_options.adaptive = args[1] == "adaptive";
+            } else {
+                throw std::runtime_error(std::string(INVALID_INPUT_STR));
+            }
+            args.erase(args.begin(), args.begin() + 2);
+        }
+        // -o - may also follow the archive name: archiver -d archive_name -o -
+        if (args.size() >= 4 && (args[0] == "-d" || args[0] == "-x") && args[2] == "-o" &&
+            args[3] == Stream::STANDARD_STREAM_NAME) {
+            is_standard_output = true;
+            args.erase(args.begin() + 2, args.begin() + 4);
+        }
+        if (is_standard_output && (args.empty() || (args[0] != "-d" && args[0] != "-x"))) {
+            throw std::runtime_error(std::string(INVALID_INPUT_STR));
+        }
+    } catch (const std::runtime_error &e) {
+        std::cout << e.what() << "\n";
+        return ERROR_CODE;
+    }
+
+    std::optional<Stream> standard_output;
+    if (is_standard_output) {
+        standard_output.emplace(Stream::STANDARD_STREAM_NAME, 'w');
+        decompress_options.output = [&standard_output](const std::string &) {
+            return decompressor::MemberSink([&standard_output](std::span<const char> data) {
+                standard_output->WriteBytes(data.data(), data.size());
+            });
+        };
+    }
+    std::ostream &extract_log = is_standard_output ? std::cerr : std::cout;
+    auto warn_without_index = [](std::string_view archive_name) {
+        if (!decompressor::HasIndex(archive_name)) {
+            std::cerr << "Note: " << archive_name << " has no index, so the whole archive is decoded. Archives "
+                      << "created with -b, -s or -a have one.\n";
+        }
+    };
+
+    if (args.size() == 1 && args[0] == "-h") {
         std::cout << HELP_COMMAND_STR << "\n";
-    } else if (argc == 3 && std::string(argv[1]) == "-d") {
+    } else if (args.size() == 2 && args[0] == "-d") {
         try {
-            decompressor::Decompress(argv[2]);
-            std::cout << "Files unarchived from " << argv[2] << "\n";
+            decompressor::Decompress(args[1], decompress_options);
+            extract_log << "Files unarchived from " << args[1] << "\n";
+        } catch (const std::runtime_error &e) {
+            extract_log << e.what() << "\n";
+            return ERROR_CODE;
+        }
+    } else if (args.size() == 2 && args[0] == "-l") {
+        try {
+            warn_without_index(args[1]);
+            for (const MemberInfo &member : decompressor::List(args[1])) {
+                std::cout << member.name << "\t" << member.original_size << "\t" << member.compressed_size << "\n";
+            }
         } catch (const std::runtime_error &e) {
             std::cout << e.what() << "\n";
             return ERROR_CODE;
         }
-    } else if (argc >= 4 && std::string(argv[1]) == "-c") {
+    } else if (args.size() >= 3 && args[0] == "-x") {
+        try {
+            decompress_options.members.assign(args.begin() + 2, args.end());
+            warn_without_index(args[1]);
+            decompressor::Extract(args[1], decompress_options);
+            extract_log << "Files ";
+            for (const std::string &member : decompress_options.members) {
+                extract_log << member << " ";
+            }
+            extract_log << "unarchived from " << args[1] << "\n";
+        } catch (const std::runtime_error &e) {
+            extract_log << e.what() << "\n";
+            return ERROR_CODE;
+        }
+    } else if (args.size() == 2 && args[0] == "-t") {
         try {
-            std::vector<std::string_view> file_names;
-            for (int i = 3; i < argc; ++i) {
-                file_names.push_back(argv[i]);
+            std::vector<MemberInfo> members = decompressor::Test(args[1], decompress_options);
+            size_t original_size = 0;
+            for (const MemberInfo &member : members) {
+                original_size += member.original_size;
             }
+            std::cout << "Archive " << args[1] << " is OK: " << members.size() << " files, " << original_size
+                      << " bytes\n";
+        } catch (const std::runtime_error &e) {
+            std::cout << e.what() << "\n";
+            return ERROR_CODE;
+        }
+    } else if (args.size() >= 3 && (args[0] == "-c" || args[0] == "-a")) {
+        std::ostream &log = args[1] == Stream::STANDARD_STREAM_NAME ? std::cerr : std::cout;
+        try {
+            std::vector<std::string_view> file_names(args.begin() + 2, args.end());
+            bool is_append = args[0] == "-a";
 
-            compressor::Compress(file_names, argv[2]);
+            CompressStats stats = is_append ? compressor::Append(file_names, args[1], compress_options)
+                                            : compressor::Compress(file_names, args[1], compress_options);
 
-            std::cout << "Files ";
-            for (int i = 3; i < argc; ++i) {
-                std::cout << argv[i] << " ";
+            log << "Files ";
+            for (std::string_view file_name : file_names) {
+                log << file_name << " ";
+            }
+            log << (is_append ? "appended to " : "archived to ") << args[1] << "\n";
+            if (print_stats) {
+                stats.Print(log, is_json_stats);
             }
-            std::cout << "archived to " << argv[2] << "\n";
         } catch (const std::runtime_error &e) {
-            std::cout << e.what() << "\n";
+            log << e.what() << "\n";
             return ERROR_CODE;
         }
     } else {